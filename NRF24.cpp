@@ -1,12 +1,74 @@
 #include "NRF24.h"
 
+NRF24 *NRF24::interruptInstance = NULL;
+
+static NRF24ArduinoSPI defaultTransport;
+
+// ackFifo entry of the credits from setFlowControl(), the others are the pipe of a response
+static const uint8_t creditsEntry = 0x80;
+
+// nrf24_response_t state
+static const uint8_t responseWaiting = 0;	// only in RAM
+static const uint8_t responseInChip = 1;
+static const uint8_t responseSent = 2;		// waiting for reportResponses()
+
 /*********************************************************
  *
  * PUBLIC
  *
  *********************************************************/
 
-bool NRF24::begin(uint8_t cePin, uint8_t csnPin, uint32_t _netmask)
+NRF24::NRF24()
+{
+	// set with setTransport(), begin() picks the default if there's none
+	transport = NULL;
+
+	// set by begin(), until then there's no chip to talk to
+	cePort = NULL;
+
+	// these can be changed before begin()
+	powerPolicy = NRF24_POWER_PER_CALL;
+	idleTimeout = 0;
+	startupDelay = 1500;
+
+	busy = 0;
+	rxBuffer = NULL;
+	rxBufferDepth = 0;
+	rxFromInterrupt = false;
+
+	memset(handlers, 0, sizeof(handlers));
+	numHandlers = 0;
+
+	sequenceTagging = false;
+	txSeq = 0;
+	numTxTargets = 0;
+	nextTxTarget = 0;
+	txHash = 0;
+	txFailed = false;
+	sources = NULL;
+	numSources = 0;
+	nextSource = 0;
+	duplicateCount = 0;
+
+	ackCount = 0;
+	responses = NULL;
+	responseDepth = 0;
+	numResponses = 0;
+	responseHandler = NULL;
+	responsesSent = false;
+
+	flowControl = false;
+	creditQueued = false;
+	txAck = false;
+	credits = NRF24_CREDITS_UNKNOWN;
+	creditTarget = 0;
+	pace = 0;
+	pacedSince = 0;
+}
+
+/*********************************************************/
+
+bool NRF24::begin(uint8_t cePin, uint8_t csnPin, uint32_t _netmask, uint8_t _irqPin)
 {
 	pinMode(cePin,OUTPUT);
 	pinMode(csnPin,OUTPUT);
@@ -18,11 +80,8 @@ bool NRF24::begin(uint8_t cePin, uint8_t csnPin, uint32_t _netmask)
 	csnPort = portOutputRegister(digitalPinToPort(csnPin));
 	csnBitMask = digitalPinToBitMask(csnPin);
 
-	SPI.begin();
-	// note: when using a prototype board with long wires it may be better to switch to /4 for better signal integrity
-	// maximum clock frequency for NRF24L01+ is 10MHz
-	// sometimes data can be corrupted so try putting a slower clock if the results are unpredicatable/weird/etc
-	SPI.setClockDivider(SPI_CLOCK_DIV4);
+	if (!transport) transport = &defaultTransport;
+	transport->begin();
 	csnHigh();
 
 	// Put us in a known state: power down mode
@@ -31,8 +90,13 @@ bool NRF24::begin(uint8_t cePin, uint8_t csnPin, uint32_t _netmask)
 	// the 4 high bits on the address are the netmask
 	netmask = _netmask;
 
-	// wait for 'power on reset'
-	delay(100);
+	// the chip may not have been reset along with us, don't trust anything we knew before
+	resyncRegisters();
+	verifyRegisters = false;
+
+	// wait for 'power on reset'. It starts when the chip gets power which normally is when we do too
+	// so no need to wait all of it if the sketch has been running for a while already
+	while (millis() < 100);
 
 	// Some initial values
 	setRetries(15, 15);
@@ -68,16 +132,24 @@ bool NRF24::begin(uint8_t cePin, uint8_t csnPin, uint32_t _netmask)
 	// set address width to 5 bytes
 	writeRegister(SETUP_AW, 0x3);
 
+	// pipes 2-5 share all but the first byte of their address with pipe 1, make sure it has the netmask
+	// even when it isn't listening itself. Only pipe 0 (our own address) is on until listenToAddress()
+	uint8_t buf[5];
+	assembleFullAddress(0, buf);
+	writeRegister(RX_ADDR_P1, buf, 5);
+	writeRegister(EN_RXADDR, ERX_P0);
+
 	// clear interrupt flags
-	writeRegister(STATUS, readRegister(STATUS) | RX_DR | TX_DS | MAX_RT);
+	writeRegister(STATUS, RX_DR | TX_DS | MAX_RT);
 
-	// save power until needed
-	setActive(false);
+	// save power until needed, unless setPowerPolicy() asked to stay on before begin()
+	setActive(powerPolicy == NRF24_POWER_ALWAYS_ON);
 
 	// no pipe activated
 	previousPipe = -1;
-	numPipes = 0;
 	previousTXAddress = 0;
+	sendState = NRF24_SEND_IDLE;
+	turnaroundTime = 0;
 
 	// enable ACK by default as it results in much more reliable transmission (at the expense of ~30% less throughput)
 	setACKEnabled(true);
@@ -86,11 +158,40 @@ bool NRF24::begin(uint8_t cePin, uint8_t csnPin, uint32_t _netmask)
 	flushRX();
 	flushTX();
 
+	irqPin = _irqPin;
+	irqFired = false;
+	irqTime = 0;
+	rxPending = false;
+	rxStamped = false;
+	rxTimestamp = 0;
+	txTimestamp = 0;
+	rxHead = 0;
+	rxCount = 0;
+	rxBacklog = false;
+
+	if (irqPin != NRF24_NO_IRQ)
+	{
+		// the chip pulls IRQ low while any of RX_DR, TX_DS or MAX_RT is set
+		pinMode(irqPin, INPUT);
+		interruptInstance = this;
+		attachInterrupt(digitalPinToInterrupt(irqPin), handleInterrupt, FALLING);
+
+		// the handler may read packets (see setRXBuffer()), other devices on the bus mustn't be interrupted
+		transport->usingInterrupt(digitalPinToInterrupt(irqPin));
+	}
+
 	return false;
 }
 
 /*********************************************************/
 
+void NRF24::setTransport(NRF24Transport &_transport)
+{
+	transport = &_transport;
+}
+
+/*********************************************************/
+
 void NRF24::setAddress(uint8_t address)
 {
 	ownAddress = address;
@@ -109,11 +210,22 @@ void NRF24::setAddress(uint8_t address)
 
 /********************************************************/
 
+uint8_t NRF24::getAddress()
+{
+	return ownAddress;
+}
+
+/********************************************************/
+
 int8_t NRF24::listenToAddress(uint8_t address)
 {
-	if (numPipes >= 5) return -1;
+	uint8_t enabled = readRegister(EN_RXADDR);
+
+	// first free pipe, unlistenToAddress() gives them back
+	uint8_t pipeIndex = 1;
+	while (pipeIndex <= 5 && (enabled & (1 << pipeIndex))) pipeIndex++;
 
-	uint8_t pipeIndex = numPipes + 1;
+	if (pipeIndex > 5) return -1;
 
 	if (pipeIndex <= 1)
 	{
@@ -128,12 +240,32 @@ int8_t NRF24::listenToAddress(uint8_t address)
 		writeRegister(RX_ADDR_P0 + pipeIndex, address);
 	}
 
-	writeRegister(EN_RXADDR, readRegister(EN_RXADDR) | (1 << pipeIndex));
+	writeRegister(EN_RXADDR, enabled | (1 << pipeIndex));
+	pipeAddresses[pipeIndex - 1] = address;
 
 	// We most likely want to listen to data so go into RX mode
 	startListening();
 
-	return numPipes++;
+	return pipeIndex - 1;
+}
+
+/********************************************************/
+
+bool NRF24::unlistenToAddress(uint8_t address)
+{
+	uint8_t enabled = readRegister(EN_RXADDR);
+
+	for (uint8_t pipeIndex = 1; pipeIndex <= 5; pipeIndex++)
+	{
+		if ((enabled & (1 << pipeIndex)) && pipeAddresses[pipeIndex - 1] == address)
+		{
+			// the address stays in the register, pipe 1 has to keep the netmask for the others anyway
+			writeRegister(EN_RXADDR, enabled & ~(1 << pipeIndex));
+			return true;
+		}
+	}
+
+	return false;
 }
 
 /********************************************************/
@@ -256,6 +388,31 @@ bool NRF24::send(uint8_t targetAddress, uint8_t *data, uint8_t length, uint8_t *
 
 int8_t NRF24::send(uint8_t targetAddress, uint8_t *data, uint8_t length, uint8_t *responseBuffer, uint8_t bufferSize, uint8_t *numAttempts)
 {
+	if (rxBuffer)
+	{
+		// keep what was received so far, the response is whatever comes in after it
+		drainRX(eventTime());
+		uint8_t before = rxCount;
+
+		if (!send(targetAddress, data, length, NULL)) return -1;
+		if (!ackEnabled) return 0;
+
+		drainRX(eventTime());
+		if (rxCount <= before) return 0;
+
+		// take it off the end of the buffer, the interrupt could otherwise reuse the slot while copying
+		noInterrupts();
+		nrf24_packet_t &packet = rxBuffer[(rxHead + rxCount - 1) % rxBufferDepth];
+		uint8_t payloadSize = packet.length;
+		if (bufferSize > payloadSize) bufferSize = payloadSize;
+		memcpy(responseBuffer, packet.data, bufferSize);
+		rxTimestamp = packet.timestamp;
+		--rxCount;
+		interrupts();
+
+		return payloadSize;
+	}
+
 	// Clear any old data from FIFO
 	flushRX();
 
@@ -267,9 +424,7 @@ int8_t NRF24::send(uint8_t targetAddress, uint8_t *data, uint8_t length, uint8_t
 	// no point looking for ACK payload if ack was disabled
 	if (ackEnabled)
 	{
-		csnLow();
-		bool ackPayloadAvailable = SPI.transfer(NOP) & RX_DR;
-		csnHigh();
+		bool ackPayloadAvailable = command(NOP) & RX_DR;
 
 		if (!ackPayloadAvailable)
 		{
@@ -294,423 +449,1855 @@ bool NRF24::send(uint8_t targetAddress, char *message)
 
 /********************************************************/
 
-bool NRF24::queueResponse(uint8_t *data, uint8_t length)
+uint16_t NRF24::sendBurst(uint8_t targetAddress, uint8_t *data, uint8_t packetSize, uint16_t numPackets, uint8_t retries)
 {
-	if (length > 32) length = 32;
+	if (sendState == NRF24_SEND_PENDING) return 0;
+	if (packetSize == 0 || numPackets == 0) return 0;
+	if (packetSize > payloadLimit()) return 0;
 
-	// must be listening to access ACK FIFO
-	bool wasListening = listening;
-	if (!listening) startListening();
+	bool ack = ackEnabled;
+	prepareTransmit(targetAddress, ack);
 
-	// first check if the FIFO is already full
-	if (readRegister(FIFO_STATUS) & TX_FULL_FIFO) return false;
+	uint16_t loaded = 0;		// packets uploaded to the FIFO
+	uint16_t completed = 0;		// packets that left the FIFO, either delivered or skipped
+	uint16_t delivered = 0;
+	uint8_t attempts = 0;		// MAX_RT rounds of the oldest packet in the FIFO
 
-	// all good, clock in the data
-	csnLow();
-	SPI.transfer(W_ACK_PAYLOAD);
-	while (length--)
+	// same as in pollSend(), only counted from the last packet that made progress
+	static const uint16_t timeout = 500;
+	uint32_t lastProgress = millis();
+
+	// CE stays high for the whole burst so the chip sends whatever is in the FIFO back to back
+	ceHigh();
+
+	while (completed < numPackets)
 	{
-		SPI.transfer(*data++);
+		// keep all 3 FIFO slots filled
+		while (loaded < numPackets && loaded - completed < 3)
+		{
+			writePayload(data + loaded * packetSize, packetSize, ack);
+			++loaded;
+		}
+
+		uint8_t status = command(NOP);
+
+		if (status & TX_DS)
+		{
+			// oldest packet is out, its slot gets refilled on the next round
+			writeRegister(STATUS, TX_DS);
+			++completed;
+			++delivered;
+			attempts = 0;
+			lastProgress = millis();
+		}
+		else if (status & MAX_RT)
+		{
+			// the failed packet stays at the head of the FIFO and the chip waits for MAX_RT to be cleared
+			ceLow();
+
+			if (attempts < retries)
+			{
+				// send it again
+				++attempts;
+				writeRegister(STATUS, MAX_RT);
+				ceHigh();
+			}
+			else
+			{
+				// Skip it. There's no way to drop only the head of the FIFO so flush everything and upload the
+				// packets that came after it again. TX_DS events may have merged, so which packet failed is worked
+				// out from how many are still in the FIFO: fill it up with junk and count
+				uint8_t inFifo = 3;
+				uint8_t junk = 0;
+				while (inFifo > 1 && !(command(NOP) & TX_FULL))
+				{
+					writeCommand(W_TX_PAYLOAD, &junk, 1);
+					--inFifo;
+				}
+
+				flushTX();
+				writeRegister(STATUS, TX_DS | MAX_RT);
+
+				// the ones in front of the failed packet were delivered
+				uint16_t failed = loaded - inFifo;
+				delivered += failed - completed;
+				completed = failed + 1;
+				loaded = completed;
+				attempts = 0;
+
+				ceHigh();
+			}
+
+			lastProgress = millis();
+		}
+		else if (loaded == numPackets && (readRegister(FIFO_STATUS) & TX_EMPTY))
+		{
+			// Everything went out. If we get here with packets unaccounted for we polled too slowly and
+			// two TX_DS events got merged into one, they were delivered all the same
+			delivered += loaded - completed;
+			completed = loaded;
+		}
+		else if (millis() - lastProgress >= timeout)
+		{
+			// chip isn't responding
+			flushTX();
+			break;
+		}
 	}
-	csnHigh();
 
-	if (!wasListening) stopListening();
+	// for finishTransmit() and writeFrame(), like after send(). Pending since prepareTransmit()
+	sendState = delivered == numPackets ? NRF24_SEND_OK : NRF24_SEND_FAILED;
+	txAck = ack;
 
-	return true;
+	finishTransmit();
+
+	return delivered;
 }
 
 /********************************************************/
 
-uint8_t NRF24::available(uint8_t *listener)
+bool NRF24::beginSend(uint8_t targetAddress, uint8_t *data, uint8_t length)
 {
-	uint8_t status = readRegister(STATUS);
-	bool rxDataReady = status & RX_DR;
-
-	if (rxDataReady)
-	{
-		if (listener)
-		{
-			*listener = (status >> RX_P_NO) & 0x3;
-		}
+	return startTransmit(targetAddress, data, length, ackEnabled);
+}
 
-		// get number of bytes available
-		return readRegister(R_RX_PL_WID);
-	}
+/********************************************************/
 
-	return 0;
+bool NRF24::beginBroadcast(uint8_t *data, uint8_t length)
+{
+	return startTransmit(ownAddress, data, length, false);
 }
 
 /********************************************************/
 
-uint8_t NRF24::read(uint8_t *buf, uint8_t bufferSize)
+bool NRF24::pollSend()
 {
-	// disable RX mode
-	ceLow();
+	if (sendState != NRF24_SEND_PENDING) return true;
 
-	uint8_t payloadSize = readRegister(R_RX_PL_WID);
+	// no need to ask the chip if the IRQ pin says nothing happened
+	uint32_t now = eventTime();
+	uint8_t status = statusChanged() ? readStatus() : 0;
 
-	// make sure we don't overflow the buffer
-	if (bufferSize > payloadSize) bufferSize = payloadSize;
+	// the timeout can occur if the chip isn't responding, shouldn't happen if everything is in order
+	static const uint16_t timeout = 500;
 
-	// fetch data from fifo
-	csnLow();
-	SPI.transfer(R_RX_PAYLOAD);
-	while (bufferSize--)
+	if (status & TX_DS)
 	{
-		*buf++ = SPI.transfer(NOP);
+		sendState = NRF24_SEND_OK;
 	}
-	csnHigh();
-
-	if (*(buf - payloadSize) == 0)
+	else if (status & MAX_RT)
 	{
-		// SOMETIMES we end up here even if the transmission is identical
+		// the transmission failed after all the attempts set in setRetries(). No ACK was received
+		sendState = NRF24_SEND_FAILED;
+	}
+	else if (millis() - txStarted >= timeout)
+	{
+		sendState = NRF24_SEND_FAILED;
+	}
+	else
+	{
+		// still in progress
+		return false;
 	}
 
-	// clear RX bit so we can receive more data
-	writeRegister(STATUS, readRegister(STATUS) | RX_DR);
-
-	// continue listening
-	ceHigh();
-
-	return payloadSize;
-}
-
-/********************************************************/
+	finishTransmit();
 
-uint8_t NRF24::read(char *buf, uint8_t bufferSize)
-{
-	uint8_t bytesRead = read((uint8_t *)buf, bufferSize - 1);
-	buf[bufferSize - 1] = '\0';
-	return bytesRead;
-}
+	// more accurate than finishTransmit() when it was the interrupt that told us
+	if (status & (TX_DS | MAX_RT)) txTimestamp = now;
 
-/********************************************************/
+	if (flowControl && txAck)
+	{
+		// new credits came with the ACK, without the IRQ pin they're still in the chip
+		pollRX();
 
-void NRF24::setActive(bool active)
-{
-	uint8_t config = readRegister(CONFIG);
-	config &= ~PWR_UP;
-	if (active) config |= PWR_UP;
-	writeRegister(CONFIG, config);
+		// this packet took one of them, or the receiver couldn't take it at all
+		noInterrupts();
+		if (previousTXAddress == creditTarget && credits != NRF24_CREDITS_UNKNOWN)
+		{
+			setCredits(sendState == NRF24_SEND_OK && credits ? credits - 1 : 0);
+		}
+		interrupts();
+	}
 
-	// Need to wait for activation. Datasheet says this should be controlled by MCU so let's be good citizens
-	// Actually only 150uS is required with external oscillator (likely) but let's be on the safe side and
-	// use 1.5mS which is the delay when using the internal oscillator
-	delayMicroseconds(1500);
+	return true;
 }
 
 /********************************************************/
 
-bool NRF24::getActive()
+nrf24_send_state_e NRF24::sendResult()
 {
-	return readRegister(CONFIG) & PWR_UP;
+	return sendState;
 }
 
 /********************************************************/
 
-nrf24_mode_e NRF24::getCurrentMode()
+bool NRF24::queueResponse(uint8_t *data, uint8_t length, uint8_t pipe)
 {
-	// Determine state. based on page 22, 23 in datasheet
-	// Requirements:
-	//   power down:	PWR_UP=0
-	//   stamdby 1:		PWR_UP=1, CE=0
-	//   standby 2:		PWR_UP=1, CE=1, PRIM_RX=0, TX_FIFO=empty
-	//   rx:			PWR_UP=1, CE=1, PRIM_RX=1
-	//   tx:			PWR_UP=1, CE=1, PRIM_RX=0, TX_FIFO=not empty
+	if (length > payloadLimit()) return false;
+	if (pipe > 5) return false;
 
-	// I guess it's possible we're in a transition state too but they last 130uS and
-	// the code changing states is blocking so probably don't need to worry about that
+	if (responses)
+	{
+		if (numResponses >= responseDepth) return false;
+
+		// the interrupt leaves the list alone while we're busy
+		++busy;
+		nrf24_response_t &response = responses[numResponses];
+		response.pipe = pipe;
+		response.length = length;
+		memcpy(response.data, data, length);
+		response.state = responseWaiting;
+		++numResponses;
+		--busy;
+
+		// goes to the chip right away if there's room
+		refillAckPayloads();
+		return true;
+	}
 
-	uint8_t config = readRegister(CONFIG);
+	// the ACK FIFO is only there in RX mode, listening is still set during a transmission
+	if (!listening || sendState == NRF24_SEND_PENDING || !(readRegister(CONFIG) & PRIM_RX)) return false;
 
-	// not doing anything, power saving mode, crystal disabled
-	if (!config & PWR_UP) return NRF24_MODE_POWER_DOWN;
+	// first check if the FIFO is already full
+	if (readRegister(FIFO_STATUS) & TX_FULL_FIFO) return false;
 
-	// waiting for some magic to happen, crystal enabled so quicker startup
-	if (!ceIsHigh()) return NRF24_MODE_STANDBY1;
+	++busy;
 
-	// listening to data
-	if (config & PRIM_RX) return NRF24_MODE_RX;
+	// TX_DS only means an ACK payload went out from here on, see drainRX()
+	if (!ackCount) writeRegister(STATUS, TX_DS);
 
-	uint8_t fifoEmpty = readRegister(FIFO_STATUS) & TX_EMPTY;
+	// all good, clock in the data
+	writeFrame(W_ACK_PAYLOAD | pipe, data, length);
+	if (ackCount < 3) ackFifo[ackCount++] = pipe;
 
-	// if the fifo is empty we're ready to send data whenever the fifo gets filled again
-	if (fifoEmpty) return NRF24_MODE_STANDBY2;
+	--busy;
 
-	// transmitting data. we shouldn't stay in this state as the call is blocking and automatically switches back
-	// maybe this is useful for debugging? :)
-	return NRF24_MODE_TX;
+	return true;
 }
 
 /********************************************************/
 
-void NRF24::startListening()
+void NRF24::clearResponses()
 {
-	// Enter RX mode
-	writeRegister(CONFIG, readRegister(CONFIG) | PRIM_RX | PWR_UP);
-	writeRegister(STATUS, RX_DR | TX_DS | MAX_RT);
-
-	// we might have sent data before which caused pipe0 to get the target address
-	if (previousRXAddress != ownAddress)
-	{
-		// restore our own address
-		uint8_t buf[5];
-		assembleFullAddress(ownAddress, buf);
-		writeRegister(RX_ADDR_P0, buf, 5);
-
-		previousRXAddress = ownAddress;
-	}
+	++busy;
+	numResponses = 0;
+	--busy;
 
-	// Transition to RX mode
-	ceHigh();
-
-	// Make sure we start from a clean slate
-	flushRX();
+	// ACK payloads wait in the TX FIFO while listening. Takes our credits along, they're written again
 	flushTX();
-
-	listening = true;
-
-	// We're in RX mode in 130uS. No point blocking this though
+	refillAckPayloads();
 }
 
 /********************************************************/
 
-void NRF24::stopListening()
+bool NRF24::setResponseBuffer(nrf24_response_t *buffer, uint8_t depth)
 {
-	// Enter Power down mode
-	writeRegister(CONFIG, readRegister(CONFIG) & ~PRIM_RX & ~PWR_UP);
-	ceLow();
+	// which ones went out is worked out from the packets going into the RX buffer
+	if (!rxBuffer && depth) return false;
 
-	// Clear any remaining data from FIFOs
-	flushRX();
+	// whatever was written without the buffer is forgotten
 	flushTX();
 
-	// Store state so we know what to transition to in the future
-	listening = false;
+	++busy;
+	responses = depth ? buffer : NULL;
+	responseDepth = depth;
+	numResponses = 0;
+	responsesSent = false;
+	--busy;
+
+	refillAckPayloads();
+
+	return true;
 }
 
 /********************************************************/
 
-void NRF24::setRetries(uint8_t delay, uint8_t count)
+uint8_t NRF24::getResponseDepth()
 {
-	// Delay between retries: delay * 250uS + 258uS
-	// Count how many times to try before giving up. Max 15
-	if (delay > 0xF) delay = 0xF;
-	if (count > 0xF) count = 0xF;
-	writeRegister(SETUP_RETR, (delay << 4) | count);
+	return responses ? responseDepth : 0;
 }
 
 /********************************************************/
 
-void NRF24::setCRCMode(nrf24_crc_mode_e mode)
+void NRF24::onResponseSent(nrf24_receive_handler_t handler)
 {
-	uint8_t config = readRegister(CONFIG);
-	config &= ~EN_CRC;
-	config &= ~CRCO;
-	if (mode == NRF24_NO_CRC) return;
-	config |= EN_CRC;
-	if (mode == NRF24_CRC_16BIT) config |= CRCO;
-	writeRegister(CONFIG, config);
+	responseHandler = handler;
 }
 
 /********************************************************/
 
-void NRF24::setACKEnabled(bool ack)
+uint8_t NRF24::available(uint8_t *listener)
 {
-	// automatically does magic on transmission
-	ackEnabled = ack;
-}
+	checkIdle();
 
+	if (rxBuffer)
+	{
+		pollRX();
 
-/*********************************************************
- *
- * PRIVATE
- *
- *********************************************************/
+		if (!rxCount) return 0;
 
-uint8_t NRF24::readRegister(uint8_t reg)
-{
-	csnLow();
-	SPI.transfer(R_REGISTER | reg);
-	uint8_t result = SPI.transfer(NOP);
-	csnHigh();
+		if (listener)
+		{
+			*listener = rxBuffer[rxHead].pipe;
+		}
 
-	return result;
-}
+		rxTimestamp = rxBuffer[rxHead].timestamp;
 
-/*********************************************************/
+		return rxBuffer[rxHead].length;
+	}
 
-void NRF24::writeRegister(uint8_t reg, uint8_t value)
-{
-	csnLow();
-	SPI.transfer(W_REGISTER | (REGISTER_MASK & reg));
-	SPI.transfer(value);
-	csnHigh();
-}
+	// nothing arrived since we last checked and the FIFO was empty back then
+	if (!rxPending && !statusChanged()) return 0;
 
-/*********************************************************/
+	uint32_t now = eventTime();
+	uint8_t status = readStatus();
 
-void NRF24::writeRegister(uint8_t reg, uint8_t *value, uint8_t numBytes)
-{
-	csnLow();
-	SPI.transfer(W_REGISTER | (REGISTER_MASK & reg));
-	while (numBytes--)
+	// RX_DR only tells something arrived, check the pipe number to see if there's still data left in the FIFO
+	uint8_t pipe = (status & RX_P_NO_MASK) >> 1;
+	rxPending = pipe <= 5;
+
+	if (rxPending)
 	{
-		SPI.transfer(*value++);
+		stamp(now);
+
+		if (listener)
+		{
+			*listener = pipe;
+		}
+
+		// get number of bytes available
+		uint8_t payloadSize = readRegister(R_RX_PL_WID);
+		if (payloadSize > tagSize()) return payloadSize - tagSize();
+
+		// nothing but the tag, there's no data to hand out. The next call looks at the FIFO again
+		read((uint8_t *)NULL, 0);
+		return 0;
 	}
-	csnHigh();
+
+	// The ACK of a resent packet can take an ACK payload along, which sets TX_DS with nothing to read.
+	// With the IRQ pin the line would stay low and no further interrupt come in
+	if ((status & (TX_DS | MAX_RT)) && rxFlags() != RX_DR) writeRegister(STATUS, TX_DS | MAX_RT);
+
+	return 0;
 }
 
-/*********************************************************/
+/********************************************************/
 
-bool NRF24::transmit(uint8_t targetAddress, uint8_t *data, uint8_t length, bool ack)
+uint8_t NRF24::read(uint8_t *buf, uint8_t bufferSize)
 {
-	// what's the point of transmitting 0 bytes? :)
-	if (length == 0) return false;
+	if (rxBuffer)
+	{
+		if (!rxCount) return 0;
 
-	// max 32 bytes allowed
-	if (length > 32) length = 32;
+		nrf24_packet_t &packet = rxBuffer[rxHead];
+		uint8_t payloadSize = packet.length;
+		if (bufferSize > payloadSize) bufferSize = payloadSize;
+		memcpy(buf, packet.data, bufferSize);
+		rxTimestamp = packet.timestamp;
 
-	// we only need to update the TX address if it's changed
-	uint8_t buf[5];
-	if (previousTXAddress != targetAddress)
-	{
-		assembleFullAddress(targetAddress, buf);
-		writeRegister(TX_ADDR, buf, 5);
+		popRX();
 
-		previousTXAddress = targetAddress;
+		return payloadSize;
 	}
 
-	// RX address doesn't matter if we won't receive an ACK
-	if (ack && previousRXAddress != targetAddress)
-	{
-		assembleFullAddress(targetAddress, buf);
+	// disable RX mode
+	ceLow();
+
+	uint8_t payloadSize = readRegister(R_RX_PL_WID);
+	uint8_t skip = payloadSize < tagSize() ? payloadSize : tagSize();
+	payloadSize -= skip;
+
+	// make sure we don't overflow the buffer
+	if (bufferSize > payloadSize) bufferSize = payloadSize;
+
+	// fetch data from fifo, the status has the pipe it came in on
+	uint8_t status = readPayload(buf, bufferSize, skip);
+
+	// in RX mode TX_DS means ACK payloads went out, the packet's ACK took the oldest one for its pipe along
+	bool acked = ackCount && (status & TX_DS);
+	if (acked) ackPayloadSent((status & RX_P_NO_MASK) >> 1);
+
+	// clear RX bit so we can receive more data
+	// writing 1 clears a flag so there's no need to read the register first
+	writeRegister(STATUS, rxFlags() | (acked ? TX_DS : 0));
+
+	// the next one gets its own timestamp
+	rxStamped = false;
+
+	// continue listening
+	ceHigh();
+
+	return payloadSize;
+}
+
+/********************************************************/
+
+uint8_t NRF24::read(char *buf, uint8_t bufferSize)
+{
+	uint8_t bytesRead = read((uint8_t *)buf, bufferSize - 1);
+	buf[bufferSize - 1] = '\0';
+	return bytesRead;
+}
+
+/********************************************************/
+
+uint8_t NRF24::receive(uint8_t *buf, uint8_t bufferSize, uint8_t *pipe)
+{
+	if (rxBuffer)
+	{
+		uint8_t payloadSize = available(pipe);
+		if (payloadSize) read(buf, bufferSize);
+		return payloadSize;
+	}
+
+	uint8_t payloadSize = nextPacket(pipe);
+	if (!payloadSize) return 0;
+
+	if (bufferSize > payloadSize) bufferSize = payloadSize;
+	readPayload(buf, bufferSize, tagSize());
+
+	packetRead();
+
+	return payloadSize;
+}
+
+/********************************************************/
+
+uint8_t NRF24::readBatch(nrf24_packet_t *packets, uint8_t maxPackets)
+{
+	uint8_t count = 0;
+
+	if (rxBuffer)
+	{
+		// they're in RAM already, oldest first
+		while (count < maxPackets && available(&packets[count].pipe))
+		{
+			packets[count].length = read(packets[count].data, sizeof(packets[count].data));
+			packets[count].timestamp = rxTimestamp;
+			++count;
+		}
+
+		return count;
+	}
+
+	checkIdle();
+
+	uint32_t now = eventTime();
+
+	// TX_DS and MAX_RT are left for pollSend()
+	if (sendState != NRF24_SEND_PENDING) irqFired = false;
+
+	// TX_DS in RX mode means ACK payloads went out, with the ACKs of the packets we're about to read
+	bool acked = ackCount && (command(NOP) & TX_DS);
+	uint8_t flags = rxFlags() | (acked ? TX_DS : 0);
+
+	// same as the RX buffer: with the IRQ pin RX_DR is cleared first so nothing arriving in the meantime is missed,
+	// otherwise once after the first packet
+	bool cleared = irqPin != NRF24_NO_IRQ;
+	if (cleared) writeRegister(STATUS, flags);
+
+	while (count < maxPackets && readPacket(packets[count]))
+	{
+		if (acked) ackPayloadSent(packets[count].pipe);
+
+		if (!stripTag(packets[count])) continue;
+
+		// the first one might have been seen by available() already
+		stamp(now);
+		packets[count].timestamp = rxTimestamp;
+		rxStamped = false;
+
+		++count;
+
+		if (!cleared)
+		{
+			writeRegister(STATUS, flags);
+			cleared = true;
+		}
+	}
+
+	// out of room, there may be more
+	rxPending = count == maxPackets;
+
+	return count;
+}
+
+/********************************************************/
+
+void NRF24::onReceive(uint8_t pipe, nrf24_receive_handler_t handler)
+{
+	if (pipe > NRF24_ANY_PIPE) return;
+
+	if (handlers[pipe] && !handler) --numHandlers;
+	if (!handlers[pipe] && handler) ++numHandlers;
+
+	handlers[pipe] = handler;
+}
+
+/********************************************************/
+
+int8_t NRF24::onReceiveAddress(uint8_t address, nrf24_receive_handler_t handler)
+{
+	int8_t pipe = 0;
+
+	if (address != ownAddress)
+	{
+		pipe = listenToAddress(address);
+		if (pipe < 0) return -1;
+		++pipe;
+	}
+
+	onReceive(pipe, handler);
+
+	return pipe;
+}
+
+/********************************************************/
+
+void NRF24::setSequenceTagging(bool enable)
+{
+	sequenceTagging = enable;
+}
+
+/********************************************************/
+
+bool NRF24::setDuplicateFilter(nrf24_source_t *_sources, uint8_t _numSources)
+{
+	// packets are checked on their way into the RX buffer
+	if (!rxBuffer && _numSources) return false;
+
+	noInterrupts();
+	sources = _numSources ? _sources : NULL;
+	numSources = _numSources;
+	nextSource = 0;
+	for (uint8_t i = 0; i < numSources; i++)
+	{
+		sources[i].used = false;
+	}
+	interrupts();
+
+	return true;
+}
+
+/********************************************************/
+
+uint16_t NRF24::getDuplicateCount()
+{
+	return duplicateCount;
+}
+
+/********************************************************/
+
+bool NRF24::setFlowControl(bool enable)
+{
+	// credits are the free space in the RX buffer, and come in through it
+	if (!rxBuffer && enable) return false;
+
+	// don't leave stale credits behind to go out with the next ACK, responses are written again
+	if (!enable && creditQueued) flushTX();
+
+	flowControl = enable;
+	credits = NRF24_CREDITS_UNKNOWN;
+	pace = 0;
+
+	refillAckPayloads();
+
+	return true;
+}
+
+/********************************************************/
+
+uint8_t NRF24::getCredits()
+{
+	return credits;
+}
+
+/********************************************************/
+
+uint32_t NRF24::getRXTimestamp()
+{
+	return rxTimestamp;
+}
+
+/********************************************************/
+
+uint32_t NRF24::getTXTimestamp()
+{
+	return txTimestamp;
+}
+
+/********************************************************/
+
+void NRF24::setRXBuffer(nrf24_packet_t *buffer, uint8_t depth, bool fromInterrupt)
+{
+	noInterrupts();
+	rxBuffer = depth ? buffer : NULL;
+	rxBufferDepth = depth;
+	rxHead = 0;
+	rxCount = 0;
+	rxFromInterrupt = fromInterrupt;
+	interrupts();
+
+	// anything already in the chip goes in on the next poll()
+	rxBacklog = rxBuffer != NULL;
+}
+
+/********************************************************/
+
+void NRF24::setActive(bool active)
+{
+	uint8_t config = readRegister(CONFIG);
+	bool wasActive = config & PWR_UP;
+	config &= ~PWR_UP;
+	if (active) config |= PWR_UP;
+	writeRegister(CONFIG, config);
+
+	// Need to wait for activation. Datasheet says this should be controlled by MCU so let's be good citizens
+	// Powering down is immediate and there's nothing to wait for when we were already active
+	if (active && !wasActive) delayMicroseconds(startupDelay);
+
+	lastActivity = millis();
+}
+
+/********************************************************/
+
+bool NRF24::getActive()
+{
+	return readRegister(CONFIG) & PWR_UP;
+}
+
+/********************************************************/
+
+void NRF24::setPowerPolicy(nrf24_power_policy_e policy, uint16_t _idleTimeout)
+{
+	powerPolicy = policy;
+	idleTimeout = _idleTimeout;
+
+	// get the startup delay out of the way now rather than on the first transmission. Before begin() the
+	// policy is only stored, begin() powers up
+	if (policy == NRF24_POWER_ALWAYS_ON && cePort) setActive(true);
+}
+
+/********************************************************/
+
+void NRF24::setStartupDelay(uint16_t _startupDelay)
+{
+	startupDelay = _startupDelay;
+}
+
+/********************************************************/
+
+void NRF24::poll()
+{
+	checkIdle();
+
+	if (rxBuffer) pollRX();
+
+	if (numHandlers) dispatch();
+
+	if (responsesSent) reportResponses();
+}
+
+/********************************************************/
+
+nrf24_mode_e NRF24::getCurrentMode()
+{
+	// Determine state. based on page 22, 23 in datasheet
+	// Requirements:
+	//   power down:	PWR_UP=0
+	//   stamdby 1:		PWR_UP=1, CE=0
+	//   standby 2:		PWR_UP=1, CE=1, PRIM_RX=0, TX_FIFO=empty
+	//   rx:			PWR_UP=1, CE=1, PRIM_RX=1
+	//   tx:			PWR_UP=1, CE=1, PRIM_RX=0, TX_FIFO=not empty
+
+	// I guess it's possible we're in a transition state too but they last 130uS and
+	// the code changing states is blocking so probably don't need to worry about that
+
+	uint8_t config = readRegister(CONFIG);
+
+	// not doing anything, power saving mode, crystal disabled
+	if (!(config & PWR_UP)) return NRF24_MODE_POWER_DOWN;
+
+	// waiting for some magic to happen, crystal enabled so quicker startup
+	if (!ceIsHigh()) return NRF24_MODE_STANDBY1;
+
+	// listening to data
+	if (config & PRIM_RX) return NRF24_MODE_RX;
+
+	uint8_t fifoEmpty = readRegister(FIFO_STATUS) & TX_EMPTY;
+
+	// if the fifo is empty we're ready to send data whenever the fifo gets filled again
+	if (fifoEmpty) return NRF24_MODE_STANDBY2;
+
+	// transmitting data. we shouldn't stay in this state as the call is blocking and automatically switches back
+	// maybe this is useful for debugging? :)
+	return NRF24_MODE_TX;
+}
+
+/********************************************************/
+
+void NRF24::startListening()
+{
+	// Make sure we start from a clean slate
+	writeRegister(STATUS, RX_DR | TX_DS | MAX_RT);
+	flushRX();
+
+	// in RX mode the TX FIFO only has ACK payloads, keep them (e.g. when listenToAddress() calls us)
+	if (!listening || !(readRegister(CONFIG) & PRIM_RX)) flushTX();
+
+	enterRXMode();
+}
+
+/********************************************************/
+
+void NRF24::stopListening()
+{
+	// Enter Power down mode
+	writeRegister(CONFIG, readRegister(CONFIG) & ~PRIM_RX & ~PWR_UP);
+	ceLow();
+
+	// Clear any remaining data from FIFOs
+	flushRX();
+	flushTX();
+
+	// Store state so we know what to transition to in the future
+	listening = false;
+}
+
+/********************************************************/
+
+void NRF24::setRetries(uint8_t delay, uint8_t count)
+{
+	// Delay between retries: delay * 250uS + 258uS
+	// Count how many times to try before giving up. Max 15
+	if (delay > 0xF) delay = 0xF;
+	if (count > 0xF) count = 0xF;
+	writeRegister(SETUP_RETR, (delay << 4) | count);
+}
+
+/********************************************************/
+
+void NRF24::setCRCMode(nrf24_crc_mode_e mode)
+{
+	uint8_t config = readRegister(CONFIG);
+	config &= ~EN_CRC;
+	config &= ~CRCO;
+	if (mode == NRF24_NO_CRC) return;
+	config |= EN_CRC;
+	if (mode == NRF24_CRC_16BIT) config |= CRCO;
+	writeRegister(CONFIG, config);
+}
+
+/********************************************************/
+
+void NRF24::setACKEnabled(bool ack)
+{
+	// automatically does magic on transmission
+	ackEnabled = ack;
+}
+
+/********************************************************/
+
+void NRF24::setListenOnly(bool listenOnly)
+{
+	writeRegister(EN_AA, listenOnly ? 0 : ENAA_P0 | ENAA_P1 | ENAA_P2 | ENAA_P3 | ENAA_P4 | ENAA_P5);
+}
+
+/********************************************************/
+
+bool NRF24::getACKEnabled()
+{
+	return ackEnabled;
+}
+
+/********************************************************/
+
+uint16_t NRF24::getTurnaroundTime()
+{
+	return turnaroundTime;
+}
+
+/********************************************************/
+
+void NRF24::setRegisterVerification(bool verify)
+{
+	verifyRegisters = verify;
+}
+
+/********************************************************/
+
+void NRF24::resyncRegisters()
+{
+	shadowValid = 0;
+}
+
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+uint8_t NRF24::readRegister(uint8_t reg)
+{
+	int8_t shadow = shadowIndex(reg);
+	if (shadow >= 0 && !verifyRegisters && (shadowValid & (1 << shadow))) return shadowRegisters[shadow];
+
+	uint8_t result;
+	readCommand(R_REGISTER | reg, &result, 1);
+
+	if (shadow >= 0)
+	{
+		shadowRegisters[shadow] = result;
+		shadowValid |= 1 << shadow;
+	}
+
+	return result;
+}
+
+/*********************************************************/
+
+void NRF24::writeRegister(uint8_t reg, uint8_t value)
+{
+	int8_t shadow = shadowIndex(reg);
+	if (shadow >= 0)
+	{
+		// nothing changes
+		if (!verifyRegisters && (shadowValid & (1 << shadow)) && shadowRegisters[shadow] == value) return;
+
+		shadowRegisters[shadow] = value;
+		shadowValid |= 1 << shadow;
+	}
+
+	writeCommand(W_REGISTER | (REGISTER_MASK & reg), &value, 1);
+}
+
+/*********************************************************/
+
+void NRF24::writeRegister(uint8_t reg, uint8_t *value, uint8_t numBytes)
+{
+	writeCommand(W_REGISTER | (REGISTER_MASK & reg), value, numBytes);
+}
+
+/*********************************************************/
+
+uint8_t NRF24::command(uint8_t cmd)
+{
+	beginCommand();
+	uint8_t status = transport->transfer(cmd);
+	endCommand();
+
+	return status;
+}
+
+/*********************************************************/
+
+uint8_t NRF24::writeCommand(uint8_t cmd, const uint8_t *data, uint8_t length)
+{
+	beginCommand();
+	uint8_t status = transport->transfer(cmd);
+	transport->transfer(data, NULL, length);
+	endCommand();
+
+	return status;
+}
+
+/*********************************************************/
+
+uint8_t NRF24::readCommand(uint8_t cmd, uint8_t *data, uint8_t length)
+{
+	beginCommand();
+	uint8_t status = transport->transfer(cmd);
+	transport->transfer(NULL, data, length);
+	endCommand();
+
+	return status;
+}
+
+/*********************************************************/
+
+int8_t NRF24::shadowIndex(uint8_t reg)
+{
+	// registers that only change when we write them
+	switch (reg)
+	{
+		case CONFIG:		return 0;
+		case EN_RXADDR:		return 1;
+		case SETUP_RETR:	return 2;
+		case RF_CH:			return 3;
+		case RF_SETUP:		return 4;
+		case FEATURE:		return 5;
+	}
+
+	return -1;
+}
+
+/*********************************************************/
+
+bool NRF24::transmit(uint8_t targetAddress, uint8_t *data, uint8_t length, bool ack)
+{
+	// the receiver said it's full, give it time to catch up
+	if (ack) while (!creditsAvailable(targetAddress));
+
+	if (!startTransmit(targetAddress, data, length, ack)) return false;
+
+	// To keep things simple let's block this and just poll the register
+	// Use beginSend() and pollSend() if there's something better to do in the meantime
+
+	// With the IRQ pin connected pollSend() only reads the status once the pin went low
+
+	// If we wanted even higher throughput we'd upload more data to the FIFO during transmission. 
+	// This is what sendBurst() does
+
+	while (!pollSend());
+
+	return sendState == NRF24_SEND_OK;
+}
+
+/*********************************************************/
+
+bool NRF24::startTransmit(uint8_t targetAddress, uint8_t *data, uint8_t length, bool ack)
+{
+	// only one transmission at a time
+	if (sendState == NRF24_SEND_PENDING) return false;
+
+	// what's the point of transmitting 0 bytes? :)
+	if (length == 0) return false;
+
+	// the tag would leave no room for the end of the data
+	if (length > payloadLimit()) return false;
+
+	if (ack && !creditsAvailable(targetAddress)) return false;
+
+	prepareTransmit(targetAddress, ack);
+	txAck = ack;
+
+	// transfer payload data to FIFO
+	writePayload(data, length, ack);
+
+	// transmit!
+	ceHigh();
+
+	// PLL takes 130uS to start up, the rest is handled by pollSend()
+	txStarted = millis();
+	sendState = NRF24_SEND_PENDING;
+
+	return true;
+}
+
+/*********************************************************/
+
+void NRF24::prepareTransmit(uint8_t targetAddress, bool ack)
+{
+	// The interrupt stays off the chip until it's in TX mode, it could write ACK payloads right after the flush.
+	// From then on the pending send keeps them out, see refillAckPayloads()
+	++busy;
+	sendState = NRF24_SEND_PENDING;
+
+	// ACK payloads would go out as packets of their own. The ones that already went with an ACK are accounted
+	// for first, the rest is written again once we're back in RX mode (if they're in the response buffer)
+	if (ackCount)
+	{
+		if (rxBuffer) drainRX(eventTime());
+		flushTX();
+	}
+
+	// we only need to update the TX address if it's changed
+	uint8_t buf[5];
+	if (previousTXAddress != targetAddress)
+	{
+		assembleFullAddress(targetAddress, buf);
+		writeRegister(TX_ADDR, buf, 5);
+
+		previousTXAddress = targetAddress;
+	}
+
+	// RX address doesn't matter if we won't receive an ACK
+	if (ack && previousRXAddress != targetAddress)
+	{
+		assembleFullAddress(targetAddress, buf);
+		writeRegister(RX_ADDR_P0, buf, 5);
+
+		previousRXAddress = targetAddress;
+
+		// note that pipe0 now has the target address; this is required to receive the ACK
+		// when we call startListening() our own address gets restored
+	}
+
+	writeRegister(STATUS, RX_DR | TX_DS | MAX_RT);
+
+	uint8_t config = readRegister(CONFIG);
+	txWasActive = config & PWR_UP;
+	txWasListening = listening;
+
+	// Need to go through Standby-I in order to transition to TX
+	ceLow();
+
+	// stopListening();
+
+	config |= PWR_UP;	// set to active to enable transmission
+	config &= ~PRIM_RX;	// disable rx mode (aka enable tx mode)
+
+	// go into PTX mode
+	writeRegister(CONFIG, config);
+
+	--busy;
+
+	if (!txWasActive) delayMicroseconds(startupDelay);	// wait to enter Standby-I mode
+}
+
+/*********************************************************/
+
+uint8_t NRF24::payloadLimit()
+{
+	return sequenceTagging ? 32 - NRF24_TAG_SIZE : 32;
+}
+
+/*********************************************************/
+
+void NRF24::writePayload(uint8_t *data, uint8_t length, bool ack)
+{
+	writeFrame(ack ? W_TX_PAYLOAD : W_TX_PAYLOAD_NO_ACK, data, length);
+}
+
+/*********************************************************/
+
+void NRF24::writeFrame(uint8_t cmd, const uint8_t *data, uint8_t length)
+{
+	if (!sequenceTagging)
+	{
+		// max 32 bytes allowed
+		if (length > 32) length = 32;
+
+		writeCommand(cmd, data, length);
+		return;
+	}
+
+	// callers check the length, see payloadLimit()
+	if (length > 32 - NRF24_TAG_SIZE) length = 32 - NRF24_TAG_SIZE;
+
+	// the chip sends an ACK payload once, there's nothing to filter
+	uint8_t tag[NRF24_TAG_SIZE] = { ownAddress, NRF24_TAG_UNNUMBERED };
+
+	if ((cmd & ~0x07) != W_ACK_PAYLOAD)
+	{
+		// The same packet again right after a failed send keeps its number. If it did arrive after all
+		// and only the ACK was lost the receiver drops it as a duplicate
+		uint16_t hash = cmd ^ (previousTXAddress << 8);
+		for (uint8_t i = 0; i < length; i++)
+		{
+			hash = hash * 31 + data[i];
+		}
+
+		uint8_t counter = txCounter(previousTXAddress);
+		if (!txFailed || hash != txHash)
+		{
+			uint8_t seq = txSeqs[counter];
+			txSeqs[counter] = (seq & NRF24_TAG_RESTART) | ((seq + 1) & NRF24_TAG_SEQ);
+		}
+
+		txHash = hash;
+		txFailed = false;
+		tag[1] = txSeqs[counter];
+	}
+
+	// tag goes in front, in the same command
+
+	beginCommand();
+	transport->transfer(cmd);
+	transport->transfer(tag, NULL, NRF24_TAG_SIZE);
+	transport->transfer(data, NULL, length);
+	endCommand();
+}
+
+/*********************************************************/
+
+void NRF24::finishTransmit()
+{
+	uint32_t txFinished = micros();
+	txTimestamp = txFinished;
+
+	// switch to Standby-I, before touching the flags: with CE high clearing MAX_RT sends the payload again
+	ceLow();
+
+	// a failed payload stays in the FIFO, don't let it go out with the next transmission (or as an ACK payload)
+	if (sendState == NRF24_SEND_FAILED) flushTX();
+
+	// interrupt has now occurred, status register updated
+	// we'll clear this interrupt on next transmission, unless the IRQ pin is used:
+	// it stays low until all flags are cleared so we'd never see it go low again
+	if (irqPin != NRF24_NO_IRQ) writeRegister(STATUS, TX_DS | MAX_RT);
+
+	// see writeFrame()
+	txFailed = sendState == NRF24_SEND_FAILED;
+
+	// the receiver knows our numbers now, it can tell duplicates from new packets
+	if (sequenceTagging && txAck && sendState == NRF24_SEND_OK)
+	{
+		txSeqs[txCounter(previousTXAddress)] &= ~NRF24_TAG_RESTART;
+	}
+
+	lastActivity = millis();
+
+	if (!txWasActive && powerPolicy == NRF24_POWER_PER_CALL)
+	{
+		// switch to power down
+		setActive(false);
+	}
+	else if (txWasListening)
+	{
+		// return back to RX. Unlike startListening() this keeps whatever is in the FIFOs,
+		// packets that arrived before the transmission and ACK payloads (see send() with responseBuffer)
+		enterRXMode();
+
+		// prepareTransmit() cleared RX_DR and the status reads while sending reset irqFired, a packet that came in
+		// before the transmission would go unnoticed. Have the next call look at the FIFO
+		rxPending = true;
+		rxBacklog = rxBuffer != NULL;
+
+		// time until we're able to receive again, including the 130uS the chip needs to settle in RX mode
+		turnaroundTime = micros() - txFinished + 130;
+	}
+
+	// otherwise we stay in Standby-I (ce low)
+}
+
+/*********************************************************/
+
+void NRF24::checkIdle()
+{
+	if (powerPolicy != NRF24_POWER_IDLE_TIMEOUT) return;
+
+	// listening needs power and a transmission in progress will finish on its own
+	if (listening || sendState == NRF24_SEND_PENDING) return;
+
+	if (millis() - lastActivity < idleTimeout) return;
+
+	// CONFIG is cached so this doesn't cost anything when we're already powered down
+	if (getActive()) setActive(false);
+}
+
+/*********************************************************/
+
+void NRF24::enterRXMode()
+{
+	// CONFIG is cached so this is a single write, or none if we were already in RX mode
+	writeRegister(CONFIG, readRegister(CONFIG) | PRIM_RX | PWR_UP);
+
+	// we might have sent data before which caused pipe0 to get the target address
+	if (previousRXAddress != ownAddress)
+	{
+		// restore our own address
+		uint8_t buf[5];
+		assembleFullAddress(ownAddress, buf);
 		writeRegister(RX_ADDR_P0, buf, 5);
 
-		previousRXAddress = targetAddress;
+		previousRXAddress = ownAddress;
+	}
+
+	// Transition to RX mode
+	ceHigh();
+
+	listening = true;
+
+	refillAckPayloads();
+
+	// We're in RX mode in 130uS. No point blocking this though
+}
+
+/*********************************************************/
+
+void NRF24::assembleFullAddress(uint8_t address, uint8_t buf[5])
+{
+	buf[4] = (netmask >> 24) & 0xFF;
+	buf[3] = (netmask >> 16) & 0xFF;
+	buf[2] = (netmask >> 8) & 0xFF;
+	buf[1] = (netmask >> 0) & 0xFF;
+	buf[0] = address;
+}
+
+/*********************************************************/
+
+void NRF24::flushTX()
+{
+	command(FLUSH_TX);
+
+	// refillAckPayloads() writes them again
+	ackCount = 0;
+	creditQueued = false;
+	for (uint8_t i = 0; i < numResponses; i++)
+	{
+		if (responses[i].state == responseInChip) responses[i].state = responseWaiting;
+	}
+}
+
+/*********************************************************/
+
+void NRF24::flushRX()
+{
+	command(FLUSH_RX);
+}
+
+/*********************************************************/
+
+uint8_t NRF24::readStatus()
+{
+	// clear the flag before reading so we don't miss an interrupt that happens in between
+	irqFired = false;
+
+	// Any SPI write will return the status register so we can save a byte by not having to input the status address
+	// Huge performance improvement! (not really, but why not)
+	return command(NOP);
+}
+
+/*********************************************************/
+
+bool NRF24::statusChanged()
+{
+	// without the IRQ pin we have to ask the chip every time
+	return irqPin == NRF24_NO_IRQ || irqFired;
+}
+
+/*********************************************************/
+
+uint8_t NRF24::rxFlags()
+{
+	// With the IRQ pin TX_DS and MAX_RT hold the line low as well, a TX_DS from an ACK payload left set means
+	// no further interrupt. They're only left for pollSend() while a send is in flight
+	if (irqPin == NRF24_NO_IRQ || sendState == NRF24_SEND_PENDING) return RX_DR;
+	return RX_DR | TX_DS | MAX_RT;
+}
+
+/*********************************************************/
+
+void NRF24::pollRX()
+{
+	// the interrupt already got everything, or couldn't because we were busy. Without IRQ pin we have to ask
+	if (!rxBacklog && !statusChanged()) return;
+
+	uint32_t now = eventTime();
+
+	// TX_DS and MAX_RT are left for pollSend()
+	if (sendState != NRF24_SEND_PENDING) irqFired = false;
+
+	drainRX(now);
+	refillAckPayloads();
+}
+
+/*********************************************************/
+
+void NRF24::drainRX(uint32_t timestamp)
+{
+	++busy;
+
+	// with the IRQ pin clear RX_DR first so a packet arriving while we're reading pulls it low again
+	bool cleared = irqPin != NRF24_NO_IRQ;
+	if (cleared) writeRegister(STATUS, RX_DR);
 
-		// note that pipe0 now has the target address; this is required to receive the ACK
-		// when we call startListening() our own address gets restored
+	// TX_DS in RX mode means ACK payloads went out, with the ACKs of the packets we're about to read
+	bool acked = ackCount && (command(NOP) & TX_DS);
+	if (acked) writeRegister(STATUS, TX_DS);
+
+	while (rxCount < rxBufferDepth && readPacket(rxBuffer[(rxHead + rxCount) % rxBufferDepth]))
+	{
+		nrf24_packet_t &packet = rxBuffer[(rxHead + rxCount) % rxBufferDepth];
+
+		// whatever happens to the packet, its ACK took the payload along
+		if (acked) ackPayloadSent(packet.pipe);
+
+		if (flowControl && takeCredits(packet)) continue;
+
+		// dropped right here so nothing further on ever sees them
+		if (sources && !acceptPacket(packet))
+		{
+			++duplicateCount;
+			continue;
+		}
+
+		if (!stripTag(packet)) continue;
+
+		packet.timestamp = timestamp;
+
+		++rxCount;
+
+		if (!cleared)
+		{
+			writeRegister(STATUS, RX_DR);
+			cleared = true;
+		}
 	}
 
-	writeRegister(STATUS, readRegister(STATUS) | RX_DR | TX_DS | MAX_RT);
+	// out of room with packets left in the chip, they're picked up once read() made space
+	rxBacklog = rxCount >= rxBufferDepth;
 
-	uint8_t config = readRegister(CONFIG);
-	bool wasActive = config & PWR_UP;
-	bool wasListening = listening;
+	// The ACK of a resent packet takes the next payload along too, but the packet is dropped as a duplicate so
+	// we never get to see it. Once the FIFO is empty we know they all went out
+	if (acked && ackCount && (readRegister(FIFO_STATUS) & TX_EMPTY))
+	{
+		while (ackCount) ackPayloadSent(ackFifo[0] & ~creditsEntry);
+	}
 
-	// Need to go through Standby-I in order to transition to TX
-	ceLow();
+	--busy;
+}
 
-	// stopListening();
+/*********************************************************/
 
-	config |= PWR_UP;	// set to active to enable transmission
-	config &= ~PRIM_RX;	// disable rx mode (aka enable tx mode)
+bool NRF24::takeCredits(nrf24_packet_t &packet)
+{
+	// ACK payloads come in on pipe 0
+	if (packet.pipe != 0 || packet.length != NRF24_CREDIT_SIZE) return false;
+	if (packet.data[0] != NRF24_CREDIT_MARKER0 || packet.data[1] != NRF24_CREDIT_MARKER1) return false;
 
-	// go into PTX mode
-	writeRegister(CONFIG, config);
+	// from whoever we sent to last
+	creditTarget = previousTXAddress;
+	if (packet.data[2]) pace = 0;
+	setCredits(packet.data[2]);
+
+	return true;
+}
 
-	if (!wasActive) delay(2);	// wait to enter Standby-I mode
+/*********************************************************/
 
-	// transfer payload data to FIFO
-	csnLow();
-	if (ack)
+void NRF24::refillAckPayloads()
+{
+	// ACK payloads can only be written in RX mode, listening is still set during a transmission
+	if (!listening || sendState == NRF24_SEND_PENDING || !(readRegister(CONFIG) & PRIM_RX)) return;
+
+	bool wanted = (flowControl && !creditQueued) || numResponses;
+	if (!wanted || ackCount >= 3) return;
+
+	++busy;
+
+	// credits first, flow control stops working when they can't get through
+	if (flowControl && !creditQueued)
 	{
-		SPI.transfer(W_TX_PAYLOAD);
+		// TX_DS only means an ACK payload went out from here on, see drainRX()
+		if (!ackCount) writeRegister(STATUS, TX_DS);
+
+		uint8_t free = rxBufferDepth - rxCount;
+		if (free == NRF24_CREDITS_UNKNOWN) --free;
+
+		uint8_t frame[NRF24_CREDIT_SIZE] = { NRF24_CREDIT_MARKER0, NRF24_CREDIT_MARKER1, free };
+		writeCommand(W_ACK_PAYLOAD, frame, NRF24_CREDIT_SIZE);
+
+		ackFifo[ackCount++] = creditsEntry;
+		creditQueued = true;
 	}
-	else
+
+	// The first round gives every pipe one slot so a busy pipe doesn't keep the others out, the second fills
+	// what's left. Each pipe's responses go out in the order they were queued
+	for (uint8_t round = 0; round < 2 && ackCount < 3; round++)
+	{
+		uint8_t inChip = 0;
+		for (uint8_t i = 0; i < ackCount; i++)
+		{
+			if (!(ackFifo[i] & creditsEntry)) inChip |= 1 << ackFifo[i];
+		}
+
+		uint8_t blocked = round == 0 ? inChip : 0;
+
+		for (uint8_t i = 0; i < numResponses && ackCount < 3; i++)
+		{
+			nrf24_response_t &response = responses[i];
+			uint8_t bit = 1 << response.pipe;
+
+			if (response.state != responseWaiting) continue;
+
+			if (!(blocked & bit))
+			{
+				if (!ackCount) writeRegister(STATUS, TX_DS);
+				writeFrame(W_ACK_PAYLOAD | response.pipe, response.data, response.length);
+				response.state = responseInChip;
+				ackFifo[ackCount++] = response.pipe;
+			}
+
+			// the ones behind it have to wait for the next round
+			blocked |= bit;
+		}
+	}
+
+	--busy;
+}
+
+/*********************************************************/
+
+void NRF24::ackPayloadSent(uint8_t pipe)
+{
+	// the chip sends the oldest payload it has for the pipe
+	for (uint8_t i = 0; i < ackCount; i++)
+	{
+		if ((ackFifo[i] & ~creditsEntry) != pipe) continue;
+
+		bool wasCredits = ackFifo[i] & creditsEntry;
+
+		--ackCount;
+		memmove(ackFifo + i, ackFifo + i + 1, ackCount - i);
+
+		if (wasCredits)
+		{
+			creditQueued = false;
+			return;
+		}
+
+		// which is also the oldest response for the pipe that's in the chip
+		for (uint8_t n = 0; n < numResponses; n++)
+		{
+			if (responses[n].pipe != pipe || responses[n].state != responseInChip) continue;
+
+			if (responseHandler)
+			{
+				responses[n].state = responseSent;
+				responsesSent = true;
+			}
+			else
+			{
+				removeResponse(n);
+			}
+			return;
+		}
+		return;
+	}
+}
+
+/*********************************************************/
+
+void NRF24::removeResponse(uint8_t index)
+{
+	--numResponses;
+	memmove(responses + index, responses + index + 1, (numResponses - index) * sizeof(nrf24_response_t));
+}
+
+/*********************************************************/
+
+void NRF24::reportResponses()
+{
+	responsesSent = false;
+
+	uint8_t i = 0;
+	while (i < numResponses)
 	{
-		SPI.transfer(W_TX_PAYLOAD_NO_ACK);
+		if (responses[i].state != responseSent)
+		{
+			++i;
+			continue;
+		}
+
+		// off the list before the handler runs so it can queue the next one in its place
+		++busy;
+		nrf24_response_t response = responses[i];
+		removeResponse(i);
+		--busy;
+
+		responseHandler(response.pipe, response.data, response.length);
 	}
-	while (length--)
+}
+
+/*********************************************************/
+
+void NRF24::setCredits(uint8_t value)
+{
+	if (value == 0 && credits != 0)
 	{
-		SPI.transfer(*data++);
+		// back off a little longer every time the receiver is still full
+		static const uint8_t maxPace = 16;
+		pace = pace ? pace * 2 : 1;
+		if (pace > maxPace) pace = maxPace;
+		pacedSince = millis();
 	}
-	csnHigh();
 
-	// transmit!
-	ceHigh();
+	credits = value;
+}
+
+/*********************************************************/
 
-	// PLL takes 130uS to start up
+bool NRF24::creditsAvailable(uint8_t targetAddress)
+{
+	if (!flowControl || targetAddress != creditTarget || credits) return true;
 
-	// -------
+	if (millis() - pacedSince < pace) return false;
 
-	// Technically we could exit at this point and separately listen to the the interrupt
-	// To keep things simple let's block this though and just poll the register
+	// waited long enough, let one through to find out if there's room again
+	credits = 1;
+	return true;
+}
 
-	// Could also poll the IRQ pin (if connected) but there doesn't seem to be a huge performance benefit so let's keep things simple
+/*********************************************************/
 
-	// If we wanted even higher throughput we'd upload more data to the FIFO during transmission. 
-	// This becomes quite messy and is very much and edge case so this is not supported.
+uint8_t NRF24::nextPacket(uint8_t *pipe)
+{
+	checkIdle();
 
-	// the timeout can occur if the chip isn't responding, shouldn't happen if everything is in order
-	static const uint16_t timeout = 500;
-	uint32_t txStarted = millis();
-	bool txComplete = false;
-	bool maxRetriesPassed = false;
-	static uint8_t status;
-	do
-	{
-		// Any SPI write will return the status register so we can save a byte by not having to input the status address
-		// Huge performance improvement! (not really, but why not)
-		csnLow();
-		status = SPI.transfer(NOP);
-		csnHigh();
-	}
-	while (
-		!(txComplete = status & TX_DS) && 
-		!(maxRetriesPassed = status & MAX_RT) &&
-		millis() < txStarted + timeout
-	);
+	if (!rxPending && !statusChanged()) return 0;
 
-	// interrupt has now occurred, status register updated
-	// we'll clear this interrupt on next transmission
+	uint32_t now = eventTime();
 
-	// If txComplete is false it means the transmission failed after all the attempts set in setRetries().
-	// No ACK was received
+	// TX_DS and MAX_RT are left for pollSend()
+	if (sendState != NRF24_SEND_PENDING) irqFired = false;
 
-	// switch to Standby-I
-	ceLow();
+	// the status comes along with the width, no need to ask for it separately
+	uint8_t payloadSize;
+	uint8_t status = readCommand(R_RX_PL_WID, &payloadSize, 1);
+	uint8_t listener = (status & RX_P_NO_MASK) >> 1;
+
+	rxPending = listener <= 5;
+	if (!rxPending) return 0;
 
-	if (!wasActive)
+	// the datasheet says to flush when this happens, the packet is corrupt
+	if (payloadSize > 32)
 	{
-		// switch to power down
-		setActive(false);
+		flushRX();
+		rxPending = false;
+		return 0;
 	}
-	else
+
+	// In RX mode TX_DS means ACK payloads went out, the packet's ACK took the oldest one for its pipe along.
+	// Cleared right away so the next packet doesn't count it again
+	if (ackCount && (status & TX_DS))
 	{
-		// return back to RX if we were there before, otherwise to Standby 1 (ce low)
-		if (wasListening) startListening();
+		ackPayloadSent(listener);
+		writeRegister(STATUS, TX_DS);
 	}
 
-	return txComplete;
+	// nothing but the tag, there's no data to hand out. rxPending has the next call look at the FIFO again
+	if (payloadSize <= tagSize())
+	{
+		readPayload(NULL, 0, payloadSize);
+		packetRead();
+		return 0;
+	}
+
+	if (pipe) *pipe = listener;
+
+	stamp(now);
+
+	// receive() and NRF24PacketReader skip the tag
+	return payloadSize - tagSize();
 }
 
 /*********************************************************/
 
-void NRF24::assembleFullAddress(uint8_t address, uint8_t buf[5])
+void NRF24::packetRead()
 {
-	buf[4] = (netmask >> 24) & 0xFF;
-	buf[3] = (netmask >> 16) & 0xFF;
-	buf[2] = (netmask >> 8) & 0xFF;
-	buf[1] = (netmask >> 0) & 0xFF;
-	buf[0] = address;
+	// RX_DR only matters for the IRQ pin, everything else goes by the pipe number.
+	// Clearing it after the read is fine: rxPending makes sure the next call looks at the FIFO again
+	if (irqPin != NRF24_NO_IRQ) writeRegister(STATUS, rxFlags());
+
+	rxStamped = false;
 }
 
 /*********************************************************/
 
-void NRF24::flushTX()
+void NRF24::stamp(uint32_t now)
 {
-	csnLow();
-	SPI.transfer(FLUSH_TX);
-	csnHigh();
+	// first time we see this packet
+	if (rxStamped) return;
+
+	rxTimestamp = now;
+	rxStamped = true;
 }
 
 /*********************************************************/
 
-void NRF24::flushRX()
+uint32_t NRF24::eventTime()
 {
-	csnLow();
-	SPI.transfer(FLUSH_RX);
-	csnHigh();
-}
\ No newline at end of file
+	// with the IRQ pin it's when the chip last raised a flag, otherwise we're only finding out now
+	return irqPin != NRF24_NO_IRQ ? irqTime : micros();
+}
+
+/*********************************************************/
+
+void NRF24::popRX()
+{
+	// the interrupt only ever adds to the end, the slot can be handed back once we're done with it
+	noInterrupts();
+	rxHead = (rxHead + 1) % rxBufferDepth;
+	--rxCount;
+	interrupts();
+}
+
+/*********************************************************/
+
+void NRF24::dispatch()
+{
+	if (rxBuffer)
+	{
+		// only what's there now, a steady stream shouldn't keep us in here forever. The interrupt only adds
+		// after these, the slots are ours until rxHead moves on
+		uint8_t count = rxCount;
+		uint8_t kept = 0;
+
+		for (uint8_t i = 0; i < count; i++)
+		{
+			nrf24_packet_t &packet = rxBuffer[(rxHead + i) % rxBufferDepth];
+			nrf24_receive_handler_t handler = handlers[packet.pipe] ? handlers[packet.pipe] : handlers[NRF24_ANY_PIPE];
+
+			if (!handler)
+			{
+				++kept;
+				continue;
+			}
+
+			rxTimestamp = packet.timestamp;
+			handler(packet.pipe, packet.data, packet.length);
+
+			// handled, the ones nobody handles move up in its place
+			packet.pipe = NRF24_ANY_PIPE;
+		}
+
+		if (kept == count) return;
+
+		// Packets nobody handles stay for available() and read() without holding up the ones behind them.
+		// Moved towards the newest so they keep their order and the slots in front can be handed back
+		uint8_t to = count;
+		for (uint8_t i = count; to > count - kept; i--)
+		{
+			nrf24_packet_t &packet = rxBuffer[(rxHead + i - 1) % rxBufferDepth];
+			if (packet.pipe == NRF24_ANY_PIPE) continue;
+
+			--to;
+			if (to != i - 1) rxBuffer[(rxHead + to) % rxBufferDepth] = packet;
+		}
+
+		noInterrupts();
+		rxHead = (rxHead + count - kept) % rxBufferDepth;
+		rxCount -= count - kept;
+		interrupts();
+
+		return;
+	}
+
+	if (!rxPending && !statusChanged()) return;
+
+	uint32_t now = eventTime();
+
+	// TX_DS and MAX_RT are left for pollSend()
+	if (sendState != NRF24_SEND_PENDING) irqFired = false;
+
+	// the flags are cleared the same way as in readBatch()
+	bool acked = ackCount && (command(NOP) & TX_DS);
+	uint8_t flags = rxFlags() | (acked ? TX_DS : 0);
+
+	bool cleared = irqPin != NRF24_NO_IRQ;
+	if (cleared) writeRegister(STATUS, flags);
+
+	for (uint8_t n = 0; n < 3; n++)
+	{
+		// the pipe comes with the width so we know who gets it before reading the payload
+		nrf24_packet_t packet;
+		uint8_t status = readCommand(R_RX_PL_WID, &packet.length, 1);
+		uint8_t pipe = (status & RX_P_NO_MASK) >> 1;
+
+		rxPending = pipe <= 5;
+		if (!rxPending) return;
+
+		// the chip only hands out the oldest one, it has to wait for read()
+		nrf24_receive_handler_t handler = handlers[pipe] ? handlers[pipe] : handlers[NRF24_ANY_PIPE];
+		if (!handler) return;
+
+		if (packet.length > 32)
+		{
+			flushRX();
+			rxPending = false;
+			return;
+		}
+
+		readCommand(R_RX_PAYLOAD, packet.data, packet.length);
+		if (acked) ackPayloadSent(pipe);
+
+		if (!cleared)
+		{
+			writeRegister(STATUS, flags);
+			cleared = true;
+		}
+
+		if (!stripTag(packet)) continue;
+
+		// for getRXTimestamp() in the handler
+		stamp(now);
+		rxStamped = false;
+
+		handler(pipe, packet.data, packet.length);
+	}
+}
+
+/*********************************************************/
+
+bool NRF24::acceptPacket(nrf24_packet_t &packet)
+{
+	// too short to have a tag, it's not from a node using setSequenceTagging()
+	if (packet.length < NRF24_TAG_SIZE) return false;
+
+	uint8_t address = packet.data[0];
+	uint8_t tag = packet.data[1];
+
+	// ACK payloads, see writeFrame()
+	if (tag & NRF24_TAG_UNNUMBERED) return true;
+
+	// the sender numbers the packets for each of our addresses on its own
+	nrf24_source_t *source = NULL;
+	for (uint8_t i = 0; i < numSources; i++)
+	{
+		if (sources[i].used && sources[i].address == address && sources[i].pipe == packet.pipe)
+		{
+			source = &sources[i];
+			break;
+		}
+	}
+
+	if (!source)
+	{
+		// new sender, takes over the oldest entry
+		source = &sources[nextSource];
+		nextSource = (nextSource + 1) % numSources;
+
+		source->address = address;
+		source->pipe = packet.pipe;
+		source->lastSeq = tag;
+		source->window = 1;
+		source->used = true;
+		return true;
+	}
+
+	if (tag & NRF24_TAG_RESTART)
+	{
+		// The sender's counter for us is new, what we had is from an older one. Only the very same packet
+		// again is a duplicate, lastSeq keeps the flag to tell
+		if (source->lastSeq == tag) return false;
+
+		source->lastSeq = tag;
+		source->window = 1;
+		return true;
+	}
+
+	uint8_t seq = tag & NRF24_TAG_SEQ;
+	uint8_t ahead = (seq - source->lastSeq) & NRF24_TAG_SEQ;
+
+	if (ahead && ahead <= NRF24_TAG_SEQ / 2)
+	{
+		// newer than anything so far, move the window along
+		source->window = ahead >= 8 ? 0 : source->window << ahead;
+		source->window |= 1;
+		source->lastSeq = seq;
+		return true;
+	}
+
+	uint8_t age = (source->lastSeq - seq) & NRF24_TAG_SEQ;
+
+	if (age >= 8)
+	{
+		// way behind, most likely the sender restarted. Start over
+		source->lastSeq = seq;
+		source->window = 1;
+		return true;
+	}
+
+	// inside the window, bit n is lastSeq - n
+	uint8_t bit = 1 << age;
+	if (source->window & bit) return false;
+
+	source->window |= bit;
+	return true;
+}
+
+/*********************************************************/
+
+uint8_t NRF24::txCounter(uint8_t targetAddress)
+{
+	for (uint8_t i = 0; i < numTxTargets; i++)
+	{
+		if (txTargets[i] == targetAddress) return i;
+	}
+
+	uint8_t counter = nextTxTarget;
+	nextTxTarget = (nextTxTarget + 1) % NRF24_TAG_TARGETS;
+	if (numTxTargets < NRF24_TAG_TARGETS) ++numTxTargets;
+
+	// Packets carry the restart flag until one of them is ACKed, see finishTransmit(). Every new counter
+	// starts somewhere else so a receiver doesn't take its first packet for the first one of the last counter
+	txTargets[counter] = targetAddress;
+	txSeqs[counter] = NRF24_TAG_RESTART | (txSeq++ & NRF24_TAG_SEQ);
+
+	return counter;
+}
+
+/*********************************************************/
+
+uint8_t NRF24::tagSize()
+{
+	// a duplicate filter implies tagging, see acceptPacket()
+	return sequenceTagging || sources ? NRF24_TAG_SIZE : 0;
+}
+
+/*********************************************************/
+
+bool NRF24::stripTag(nrf24_packet_t &packet)
+{
+	uint8_t skip = tagSize();
+	if (!skip) return true;
+
+	// nothing but the tag (or not even that), there's no data for anyone
+	if (packet.length <= skip) return false;
+
+	packet.length -= skip;
+	memmove(packet.data, packet.data + skip, packet.length);
+
+	return true;
+}
+
+/*********************************************************/
+
+uint8_t NRF24::readPayload(uint8_t *buf, uint8_t length, uint8_t skip)
+{
+	// the tag is clocked out in the same command and thrown away
+	beginCommand();
+	uint8_t status = transport->transfer(R_RX_PAYLOAD);
+	if (skip) transport->transfer(NULL, NULL, skip);
+	transport->transfer(NULL, buf, length);
+	endCommand();
+
+	return status;
+}
+
+/*********************************************************/
+
+bool NRF24::readPacket(nrf24_packet_t &packet)
+{
+	// the width comes with the status, which has the pipe of the packet it belongs to
+	uint8_t status = readCommand(R_RX_PL_WID, &packet.length, 1);
+	packet.pipe = (status & RX_P_NO_MASK) >> 1;
+
+	if (packet.pipe > 5) return false;
+
+	// the datasheet says to flush when this happens, the packet is corrupt
+	if (packet.length > 32)
+	{
+		flushRX();
+		return false;
+	}
+
+	readCommand(R_RX_PAYLOAD, packet.data, packet.length);
+
+	return true;
+}
+
+/*********************************************************/
+
+void NRF24::handleInterrupt()
+{
+	NRF24 *radio = interruptInstance;
+	radio->irqTime = micros();
+
+	// SPI only when the main code isn't in the middle of a transfer itself, otherwise the flags
+	// are read out the next time the status is needed
+	if (radio->rxBuffer && radio->rxFromInterrupt && !radio->busy)
+	{
+		radio->drainRX(radio->irqTime);
+		radio->refillAckPayloads();
+
+		// TX_DS or MAX_RT might be what fired
+		if (radio->sendState == NRF24_SEND_PENDING) radio->irqFired = true;
+		return;
+	}
+
+	radio->irqFired = true;
+}
@@ -5,6 +5,7 @@
 #include <SPI.h>
 
 #include "NRF24Reg.h"
+#include "NRF24Transport.h"
 
 typedef enum
 {
@@ -37,18 +38,96 @@ typedef enum
 	NRF24_MODE_TX
 } nrf24_mode_e;
 
+typedef enum
+{
+	NRF24_SEND_IDLE = 0,	// nothing sent yet
+	NRF24_SEND_PENDING,		// transmission in progress, keep calling pollSend()
+	NRF24_SEND_OK,			// delivered (ACK received or, without ACK, sent)
+	NRF24_SEND_FAILED		// no ACK after all retries or the chip didn't respond
+} nrf24_send_state_e;
+
+typedef enum
+{
+	NRF24_POWER_PER_CALL = 0,	// power down after every transmission unless setActive(true) was called
+	NRF24_POWER_ALWAYS_ON,		// stay in Standby-I between transmissions. Fastest, uses most power (~26uA vs ~1uA)
+	NRF24_POWER_IDLE_TIMEOUT	// stay powered up after a transmission, power down once idle for a while (see poll())
+} nrf24_power_policy_e;
+
+// pass as irqPin to begin() when the IRQ pin isn't connected
+#define NRF24_NO_IRQ 0xFF
+
+// A received packet, see setRXBuffer()
+typedef struct
+{
+	uint8_t pipe;		// same as the listener from available()
+	uint8_t length;
+	uint8_t data[32];
+	uint32_t timestamp;	// see getRXTimestamp()
+} nrf24_packet_t;
+
+// see setDuplicateFilter()
+typedef struct
+{
+	uint8_t address;
+	uint8_t pipe;		// every target a sender has counts on its own
+	uint8_t lastSeq;
+	uint8_t window;		// bit n set: lastSeq - n was received
+	bool used;
+} nrf24_source_t;
+
+// see setResponseBuffer()
+typedef struct
+{
+	uint8_t pipe;
+	uint8_t length;
+	uint8_t data[32];
+	uint8_t state;		// used by the library
+} nrf24_response_t;
+
+// bytes taken from every payload by setSequenceTagging(): the sender's address and a sequence number with flags
+#define NRF24_TAG_SIZE 2
+#define NRF24_TAG_SEQ			0x3F
+#define NRF24_TAG_RESTART		0x40	// numbering to this target starts over, the receiver forgets what it had
+#define NRF24_TAG_UNNUMBERED	0x80	// ACK payload, these can't arrive twice
+
+// targets setSequenceTagging() keeps a counter for, the oldest one makes room for a new target
+#define NRF24_TAG_TARGETS 4
+
+// ACK payload used by setFlowControl(), the last byte is the number of packets the receiver has room for
+#define NRF24_CREDIT_SIZE 3
+#define NRF24_CREDIT_MARKER0 0xC7
+#define NRF24_CREDIT_MARKER1 0x5A
+#define NRF24_CREDITS_UNKNOWN 0xFF
+
+// see onReceive(), data is only valid during the call
+typedef void (*nrf24_receive_handler_t)(uint8_t pipe, uint8_t *data, uint8_t length);
+
+// pass as pipe to onReceive() to get packets from pipes without a handler of their own
+#define NRF24_ANY_PIPE 6
+
 class NRF24
 {
 	public:
+		NRF24();
+
 		// Netmask should be something "random"
 		// All nodes that talk to eachother need to have the same netmask
 		// 10101010.. can continue on preamble and cause missed packets
 		// 11110000.. with only one logic transition can cause missed packets
-		bool begin(uint8_t cePin, uint8_t csnPin, uint32_t netmask = 0xC2C2C2C2);
+		// The chip needs 100mS after power on, begin() waits for whatever is left of that since the Arduino started
+		// The IRQ pin is optional. When connected (to a pin with an external interrupt) available() and the send functions
+		// only access the chip when the interrupt has fired. Only one radio at a time can use the IRQ pin
+		bool begin(uint8_t cePin, uint8_t csnPin, uint32_t netmask = 0xC2C2C2C2, uint8_t irqPin = NRF24_NO_IRQ);
+
+		// Use a different SPI implementation (see NRF24Transport.h), must be called before begin()
+		// The default is the Arduino SPI library at 4MHz
+		void setTransport(NRF24Transport &transport);
 
 		// Logical RF channels
 		void setAddress(uint8_t address);
+		uint8_t getAddress();
 		int8_t listenToAddress(uint8_t address);
+		bool unlistenToAddress(uint8_t address);	// frees the pipe for another listenToAddress()
 
 		// Physical RF channel
 		void setChannel(uint8_t channel);
@@ -70,45 +149,219 @@ class NRF24
 		int8_t send(uint8_t targetAddress, uint8_t *data, uint8_t length, uint8_t *responseBuffer, uint8_t bufferSize, uint8_t *numAttempts = NULL);
 		bool send(uint8_t targetAddress, char *message);
 
-		bool queueResponse(uint8_t *data, uint8_t length);
-
+		// Non-blocking versions of send() and broadcast(). The payload is uploaded and the transmission started
+		// but the call returns right away. Keep calling pollSend() until it returns true, then check sendResult()
+		// Don't use any other radio functions while a transmission is pending
+		// returns false if the transmission couldn't be started (i.e. another one is still pending)
+		bool beginSend(uint8_t targetAddress, uint8_t *data, uint8_t length);
+		bool beginBroadcast(uint8_t *data, uint8_t length);
+		bool pollSend();
+		nrf24_send_state_e sendResult();
+
+		// Stream numPackets packets of packetSize bytes, stored back to back in data, keeping the TX FIFO full
+		// the whole time. Much higher throughput than calling send() in a loop
+		// Works like send(): packets are ACKed unless disabled with setACKEnabled()
+		// A packet that reaches the retry limit from setRetries() is sent again up to retries more times, then skipped
+		// returns the number of packets delivered
+		uint16_t sendBurst(uint8_t targetAddress, uint8_t *data, uint8_t packetSize, uint16_t numPackets, uint8_t retries = 0);
+
+		// Data to go back with the ACK of the next packet that comes in on pipe (the listener from available()),
+		// so the sender gets it without a transmission of its own (see send() with responseBuffer)
+		// The chip has room for 3 of them. Without a response buffer they're written straight to it, which only
+		// works while listening, and whatever hasn't gone out is dropped when we send something ourselves
+		// returns false if there's no room
+		bool queueResponse(uint8_t *data, uint8_t length, uint8_t pipe = 0);
+		void clearResponses();		// drop responses that haven't been sent yet
+
+		// Keep up to depth responses in RAM and top up the chip from it as ACKs go out, a few per pipe at a time
+		// They can be queued at any time and stay queued through transmissions, startListening() and stopListening()
+		// Needs an RX buffer (see setRXBuffer()) to tell which ones went out, returns false without one
+		// poll() passes each response that went out to the handler and frees its slot. Without a handler the slot is
+		// freed right away. Went out means it was sent with an ACK, which can still get lost on its way
+		bool setResponseBuffer(nrf24_response_t *buffer, uint8_t depth);
+		uint8_t getResponseDepth();		// 0 without a response buffer
+		void onResponseSent(nrf24_receive_handler_t handler);
+
+		// returns the size of the next packet, 0 if there's none
+		// listener is set to the pipe the packet came in on: 0 for our own address, otherwise listenToAddress() + 1
 		uint8_t available(uint8_t *listener = NULL);
 		uint8_t read(uint8_t *buf, uint8_t bufferSize);		// raw data
 		uint8_t read(char *buf, uint8_t bufferSize);		// makes sure data is 0 terminated
 
+		// available() and read() in one, takes 2 SPI transactions (3 with the IRQ pin) instead of 6
+		// returns the size of the packet like read(), 0 if there's none. pipe is the listener from available()
+		uint8_t receive(uint8_t *buf, uint8_t bufferSize, uint8_t *pipe = NULL);
+
+		// Everything that's waiting at once, up to maxPackets, with a lot less SPI traffic than available() and read()
+		// for each of them. returns the number of packets
+		uint8_t readBatch(nrf24_packet_t *packets, uint8_t maxPackets);
+
+		// Have poll() pass packets straight to a handler instead of going through available() and read()
+		// The pipe is the listener from available(). The payload isn't copied, data points into the RX buffer
+		// (or the stack without one). Packets nobody handles stay where they are for available() and read()
+		// With an RX buffer the packets behind them are still dispatched. Without one the chip only hands out the
+		// oldest packet, one nobody handles holds up the rest until read() takes it (or register NRF24_ANY_PIPE)
+		// A NULL handler removes it again
+		void onReceive(uint8_t pipe, nrf24_receive_handler_t handler);
+		int8_t onReceiveAddress(uint8_t address, nrf24_receive_handler_t handler);	// listens to it if needed, returns the pipe or -1
+
+		// Duplicate suppression. The chip already drops a packet that was resent because the ACK got lost, but not
+		// when the send failed and the application sends the same thing again, so a command could be carried out twice
+		// With tagging every packet (and ACK payload) starts with our address and a sequence number, leaving 30 bytes
+		// for data, longer payloads are refused. Every target has its own numbers (the last NRF24_TAG_TARGETS of them,
+		// a new one starts over until a packet to it was ACKed), the number stays the same when the data is sent again
+		// right after a failed send. Received packets and ACK payloads come without the tag, filter or not
+		// The receiver keeps the last 8 sequence numbers of up to numSources senders and pipes and drops packets it's
+		// seen already, before they go in the RX buffer (which it needs, see setRXBuffer()). returns false without one
+		// Both ends have to agree on tagging like they do on the netmask. NRF24Messenger and NRF24Stream need the
+		// full 32 bytes and don't work with it
+		void setSequenceTagging(bool enable);
+		bool setDuplicateFilter(nrf24_source_t *sources, uint8_t numSources);
+		uint16_t getDuplicateCount();		// packets dropped so far
+
+		// micros() when the packet from available(), read() or receive() (or the one passed to a handler) arrived.
+		// With the IRQ pin that's when the interrupt fired, otherwise when available() or poll() first saw it
+		uint32_t getRXTimestamp();
+		// micros() when the last transmission finished, i.e. when the ACK came in
+		uint32_t getTXTimestamp();
+
+		// Keep up to depth received packets in RAM rather than just the 3 the chip has room for, so a slow loop()
+		// doesn't lose any. available() and read() work as before but take from the buffer
+		// It's filled by poll() and available(), or right away in the interrupt with fromInterrupt set
+		// (needs the IRQ pin, see begin()). When it's full packets stay in the chip unACKed and the sender retries
+		// Filling it from the interrupt with other devices on the bus needs a transport that uses SPI transactions,
+		// like the default one, not NRF24AvrSPI
+		void setRXBuffer(nrf24_packet_t *buffer, uint8_t depth, bool fromInterrupt = false);
+
+		// Flow control. A receiver keeps the free space in its RX buffer queued as ACK payload, so every packet sent
+		// to its own address brings back how much more it can take. A sender that's told the receiver is full waits
+		// before sending to it again instead of burning airtime on retries, a little longer every time it's still full
+		// send() waits, beginSend() returns false while it has to. sendBurst() and broadcasts aren't paced
+		// Both ends need an RX buffer (see setRXBuffer()), returns false without one. ACK payloads of
+		// NRF24_CREDIT_SIZE bytes starting with the markers are taken by it
+		bool setFlowControl(bool enable);
+		uint8_t getCredits();		// packets the last receiver that told us has room for, NRF24_CREDITS_UNKNOWN if none did
+
 		void setActive(bool active);
 		bool getActive();
 
+		// What to do with the power between transmissions, the idle timeout is in mS. Can be called before begin()
+		void setPowerPolicy(nrf24_power_policy_e policy, uint16_t idleTimeout = 0);
+
+		// Time the crystal needs to start when powering up, in uS. Defaults to the worst case of 1.5mS,
+		// 150uS is enough for a module with an external crystal (which is almost all of them)
+		void setStartupDelay(uint16_t startupDelay);
+
+		// Housekeeping, call from loop(). Powers down the radio when the idle timeout has passed,
+		// fills the RX buffer and calls the onReceive() handlers. available() does the first two too
+		void poll();
+
 		nrf24_mode_e getCurrentMode();
 
+		// startListening() clears the FIFOs (except for queued responses when already listening), after a transmission
+		// the radio goes back to listening without doing so
 		void startListening();
 		void stopListening();
 
+		// How long it took to get back to listening after the last transmission in uS, including the chip's settling time
+		uint16_t getTurnaroundTime();
+
 		void setRetries(uint8_t delay, uint8_t count);
 		void setCRCMode(nrf24_crc_mode_e mode);
 
 		void setACKEnabled(bool ack = true);
+		bool getACKEnabled();
+
+		// Receive without ACKing, to listen in on other nodes' traffic without getting in the way (see NRF24Capture)
+		// Sending with ACK doesn't work in this mode, the ACK isn't accepted either
+		// The datasheet requires auto ACK for dynamic payloads, which is all this library sends. Not every chip
+		// receives them without it, check with the hardware at hand. NRF24Sim goes by the datasheet and receives nothing
+		void setListenOnly(bool listenOnly);
+
+		// Configuration registers (CONFIG, EN_RXADDR, SETUP_RETR, RF_CH, RF_SETUP and FEATURE) are kept in RAM
+		// so they don't have to be read back from the chip before every change
+		// With verification enabled they're read from the chip anyway and the copy is corrected if they differ,
+		// useful if the radio could reset on its own (e.g. brownout on a separate supply)
+		void setRegisterVerification(bool verify);
+		void resyncRegisters();		// forget the copies, the chip is asked again next time
 
 		uint8_t ownAddress;
 
 	private:
+		friend class NRF24PacketReader;
+
 		void ceHigh()  { *cePort |= ceBitMask;    };
 		void ceLow()   { *cePort &= ~ceBitMask;   };
 		bool ceIsHigh(){ return *ceInput & ceBitMask; };
 		void csnHigh() { *csnPort |= csnBitMask;  };
 		void csnLow()  { *csnPort &= ~csnBitMask; };
 
+		// busy keeps the interrupt handler off the bus, see handleInterrupt()
+		void beginCommand() { ++busy; transport->beginTransaction(); csnLow(); };
+		void endCommand()   { csnHigh(); transport->endTransaction(); --busy; };
+
+		// single SPI commands, all of them return the STATUS register
+		uint8_t command(uint8_t cmd);
+		uint8_t writeCommand(uint8_t cmd, const uint8_t *data, uint8_t length);
+		uint8_t readCommand(uint8_t cmd, uint8_t *data, uint8_t length);
+
 		uint8_t readRegister(uint8_t reg);
 		void writeRegister(uint8_t reg, uint8_t value);
 		void writeRegister(uint8_t reg, uint8_t *value, uint8_t numBytes);
+		static int8_t shadowIndex(uint8_t reg);
 
 		bool transmit(uint8_t targetAddress, uint8_t *data, uint8_t length, bool ack = true);
+		bool startTransmit(uint8_t targetAddress, uint8_t *data, uint8_t length, bool ack);
+		void prepareTransmit(uint8_t targetAddress, bool ack);
+		void writePayload(uint8_t *data, uint8_t length, bool ack);
+		void writeFrame(uint8_t cmd, const uint8_t *data, uint8_t length);
+		uint8_t payloadLimit();		// 32 bytes, less the tag with setSequenceTagging()
+		void finishTransmit();
+		void enterRXMode();
+		void checkIdle();
 
 		void assembleFullAddress(uint8_t address, uint8_t buf[5]);
 
 		void flushTX();
 		void flushRX();
 
+		uint8_t readStatus();
+		bool statusChanged();
+
+		// the STATUS flags to clear once packets have been read without the RX buffer
+		uint8_t rxFlags();
+
+		void pollRX();
+		void drainRX(uint32_t timestamp);
+		bool takeCredits(nrf24_packet_t &packet);
+		void refillAckPayloads();
+		void ackPayloadSent(uint8_t pipe);
+		void removeResponse(uint8_t index);
+		void reportResponses();
+		void setCredits(uint8_t value);
+		bool creditsAvailable(uint8_t targetAddress);
+		bool readPacket(nrf24_packet_t &packet);
+		bool acceptPacket(nrf24_packet_t &packet);
+
+		// setSequenceTagging(): every packet starts with the tag, nothing past the RX FIFO sees it
+		uint8_t tagSize();
+		uint8_t txCounter(uint8_t targetAddress);	// index in txTargets, a new target takes over the oldest
+		bool stripTag(nrf24_packet_t &packet);
+		uint8_t readPayload(uint8_t *buf, uint8_t length, uint8_t skip);
+		void dispatch();
+		void popRX();
+
+		// for receive() and NRF24PacketReader: size and pipe of the packet at the head of the FIFO,
+		// packetRead() once it's been read
+		uint8_t nextPacket(uint8_t *pipe);
+		void packetRead();
+
+		void stamp(uint32_t now);
+		uint32_t eventTime();
+
+		static void handleInterrupt();
+		static NRF24 *interruptInstance;
+
 		
 		bool listening;
 		uint8_t previousTXAddress;
@@ -116,10 +369,89 @@ class NRF24
 
 		bool ackEnabled;
 
+		// copies of the configuration registers, see shadowIndex()
+		uint8_t shadowRegisters[6];
+		uint8_t shadowValid;
+		bool verifyRegisters;
+
+		// state of the transmission started by startTransmit()
+		nrf24_send_state_e sendState;
+		bool txWasActive;
+		bool txWasListening;
+		uint32_t txStarted;
+		uint16_t turnaroundTime;
+
+		nrf24_power_policy_e powerPolicy;
+		uint16_t idleTimeout;
+		uint16_t startupDelay;
+		uint32_t lastActivity;
+
 		uint32_t netmask;
-		uint8_t numPipes;
+		uint8_t pipeAddresses[5];	// pipes 1-5
 		int8_t previousPipe;
 
+		// set by the interrupt handler whenever the IRQ pin goes low (RX_DR, TX_DS or MAX_RT was set)
+		uint8_t irqPin;
+		volatile bool irqFired;
+		volatile uint32_t irqTime;
+		bool rxPending;
+
+		// getRXTimestamp(), rxStamped is set once the packet at the head of the FIFO has its timestamp
+		uint32_t rxTimestamp;
+		bool rxStamped;
+		uint32_t txTimestamp;
+		volatile uint8_t busy;
+
+		// ring buffer from setRXBuffer(), rxBacklog is set when it filled up with packets left in the chip
+		nrf24_packet_t *rxBuffer;
+		uint8_t rxBufferDepth;
+		volatile uint8_t rxHead;
+		volatile uint8_t rxCount;
+		bool rxFromInterrupt;
+		bool rxBacklog;
+
+		// setSequenceTagging() and setDuplicateFilter()
+		// txTargets and txSeqs are the counters per target, txSeq is where the next new one starts
+		bool sequenceTagging;
+		uint8_t txSeq;
+		uint8_t txTargets[NRF24_TAG_TARGETS];
+		uint8_t txSeqs[NRF24_TAG_TARGETS];
+		uint8_t numTxTargets;
+		uint8_t nextTxTarget;
+		uint16_t txHash;
+		bool txFailed;
+		nrf24_source_t *sources;
+		uint8_t numSources;
+		uint8_t nextSource;
+		uint16_t duplicateCount;
+
+		// ACK payloads in the chip's TX FIFO in the order they were written: their pipe, or creditsEntry for our credits
+		uint8_t ackFifo[3];
+		uint8_t ackCount;
+
+		// setResponseBuffer(), responsesSent is set when there's something for the handler
+		nrf24_response_t *responses;
+		uint8_t responseDepth;
+		uint8_t numResponses;
+		nrf24_receive_handler_t responseHandler;
+		volatile bool responsesSent;
+
+		// setFlowControl(). creditQueued is set while our credits wait in the TX FIFO, credits are the ones
+		// creditTarget gave us. While it has none we wait pace mS from pacedSince
+		bool flowControl;
+		bool creditQueued;
+		bool txAck;
+		uint8_t credits;
+		uint8_t creditTarget;
+		uint8_t pace;
+		uint32_t pacedSince;
+
+		// per pipe, the last one is NRF24_ANY_PIPE
+		nrf24_receive_handler_t handlers[7];
+		uint8_t numHandlers;
+
+		NRF24Transport *transport;
+
 		volatile uint8_t *cePort;
 		volatile uint8_t *ceInput;
 		uint8_t ceBitMask;
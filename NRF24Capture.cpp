@@ -0,0 +1,103 @@
+#include "NRF24Capture.h"
+
+/*********************************************************
+ *
+ * PUBLIC
+ *
+ *********************************************************/
+
+NRF24Capture::NRF24Capture(NRF24 &_radio, Print &_out)
+	: radio(_radio), out(_out)
+{
+	packetCount = 0;
+}
+
+/*********************************************************/
+
+bool NRF24Capture::begin(uint8_t *_addresses, uint8_t numAddresses)
+{
+	if (numAddresses == 0 || numAddresses > 6) return false;
+
+	// the first one goes on pipe 0, the rest on 1-5 in order
+	radio.setAddress(_addresses[0]);
+	addresses[0] = _addresses[0];
+
+	for (uint8_t i = 1; i < numAddresses; i++)
+	{
+		int8_t slot = radio.listenToAddress(_addresses[i]);
+		if (slot < 0) return false;
+
+		addresses[slot + 1] = _addresses[i];
+	}
+
+	radio.setListenOnly(true);
+	radio.startListening();
+
+	return true;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Capture::poll()
+{
+	// all of the FIFO in one go
+	nrf24_packet_t packets[3];
+	uint8_t count = radio.readBatch(packets, 3);
+	if (!count) return 0;
+
+	uint8_t channel = radio.getChannel();
+
+	// one write for all of them, printing is what limits the rate
+	uint8_t records[3 * NRF24_CAPTURE_MAX_RECORD];
+	uint16_t length = 0;
+
+	for (uint8_t i = 0; i < count; i++)
+	{
+		length += formatRecord(records + length, packets[i], packets[i].timestamp, channel);
+	}
+
+	out.write(records, length);
+
+	packetCount += count;
+
+	return count;
+}
+
+/*********************************************************/
+
+uint32_t NRF24Capture::getPacketCount()
+{
+	return packetCount;
+}
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+uint8_t NRF24Capture::formatRecord(uint8_t *record, nrf24_packet_t &packet, uint32_t timestamp, uint8_t channel)
+{
+	record[0] = NRF24_CAPTURE_SYNC1;
+	record[1] = NRF24_CAPTURE_SYNC2;
+	record[2] = NRF24_CAPTURE_HEADER_SIZE + packet.length;
+
+	uint8_t *body = record + 3;
+	body[0] = timestamp;
+	body[1] = timestamp >> 8;
+	body[2] = timestamp >> 16;
+	body[3] = timestamp >> 24;
+	body[4] = channel;
+	body[5] = packet.pipe;
+	body[6] = packet.pipe < 6 ? addresses[packet.pipe] : 0;
+	memcpy(body + NRF24_CAPTURE_HEADER_SIZE, packet.data, packet.length);
+
+	uint8_t checksum = 0;
+	for (uint8_t i = 0; i < record[2]; i++)
+	{
+		checksum += body[i];
+	}
+	body[record[2]] = checksum;
+
+	return 3 + record[2] + 1;
+}
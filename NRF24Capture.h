@@ -0,0 +1,48 @@
+#ifndef NRF24CAPTURE_H_
+#define NRF24CAPTURE_H_
+
+#include "NRF24.h"
+
+// Trace format, one record per packet:
+//   0xA5 0x5A                 sync
+//   length                    number of bytes up to the checksum
+//   timestamp                 4 bytes, micros() when the packet arrived (see NRF24::getRXTimestamp()), least significant byte first
+//   channel, pipe, address    address is the node address the pipe listens to
+//   payload
+//   checksum                  8 bit sum of the bytes between length and checksum
+// extras/host/nrf24_pcap.cpp turns a trace into a pcap file
+#define NRF24_CAPTURE_SYNC1			0xA5
+#define NRF24_CAPTURE_SYNC2			0x5A
+#define NRF24_CAPTURE_HEADER_SIZE	7
+#define NRF24_CAPTURE_MAX_RECORD	(3 + NRF24_CAPTURE_HEADER_SIZE + 32 + 1)
+
+// Records every packet sent to a set of node addresses and streams it out (usually Serial) in a compact
+// binary format. The radio doesn't ACK, so the nodes talking to each other don't notice the sniffer
+// That relies on the chip taking dynamic payloads with auto ACK off, which the datasheet doesn't allow (see
+// NRF24::setListenOnly()). Try it with the hardware at hand before relying on it
+// Use a fast baud rate and an RX buffer (see NRF24::setRXBuffer()) to get through bursts
+class NRF24Capture
+{
+	public:
+		NRF24Capture(NRF24 &radio, Print &out);
+
+		// listens to up to 6 node addresses. Call after radio.begin() and any channel and data rate changes
+		bool begin(uint8_t *addresses, uint8_t numAddresses);
+
+		// Writes what came in since the last call, call as often as possible
+		// returns the number of packets
+		uint8_t poll();
+
+		uint32_t getPacketCount();
+
+	private:
+		uint8_t formatRecord(uint8_t *record, nrf24_packet_t &packet, uint32_t timestamp, uint8_t channel);
+
+		NRF24 &radio;
+		Print &out;
+
+		uint8_t addresses[6];
+		uint32_t packetCount;
+};
+
+#endif // NRF24CAPTURE_H_
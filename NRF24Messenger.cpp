@@ -0,0 +1,227 @@
+#include "NRF24Messenger.h"
+
+/*********************************************************
+ *
+ * PUBLIC
+ *
+ *********************************************************/
+
+NRF24Messenger::NRF24Messenger(NRF24 &_radio, uint8_t *_buffer, uint16_t bufferSize, uint8_t _numSlots, uint8_t _maxPerPipe)
+	: radio(_radio)
+{
+	if (_numSlots == 0) _numSlots = 1;
+	if (_numSlots > NRF24_MESSAGE_MAX_SLOTS) _numSlots = NRF24_MESSAGE_MAX_SLOTS;
+
+	// the tag is only 2 bits
+	if (_maxPerPipe == 0) _maxPerPipe = 1;
+	if (_maxPerPipe > 4) _maxPerPipe = 4;
+
+	buffer = _buffer;
+	numSlots = _numSlots;
+	slotSize = bufferSize / _numSlots;
+	maxPerPipe = _maxPerPipe;
+
+	for (uint8_t i = 0; i < NRF24_MESSAGE_MAX_SLOTS; i++)
+	{
+		slots[i].active = false;
+	}
+
+	clock = 0;
+	nextTag = 0;
+}
+
+/*********************************************************/
+
+bool NRF24Messenger::sendMessage(uint8_t targetAddress, uint8_t *data, uint16_t length)
+{
+	return transmitMessage(targetAddress, data, length, false);
+}
+
+/*********************************************************/
+
+bool NRF24Messenger::broadcastMessage(uint8_t *data, uint16_t length)
+{
+	return transmitMessage(0, data, length, true);
+}
+
+/*********************************************************/
+
+uint16_t NRF24Messenger::readMessage(uint8_t *buf, uint16_t bufferSize, uint8_t *pipe)
+{
+	uint8_t frame[32];
+	uint8_t framePipe;
+
+	while (radio.available(&framePipe))
+	{
+		uint8_t length = radio.read(frame, sizeof(frame));
+
+		// not one of ours
+		if (length == 0 || length > sizeof(frame)) continue;
+
+		uint8_t header = frame[0];
+		uint8_t tag = header >> NRF24_MESSAGE_TAG_SHIFT;
+		uint8_t index = header & NRF24_MESSAGE_INDEX;
+		bool last = header & NRF24_MESSAGE_LAST;
+
+		uint8_t *payload = frame + 1;
+		length--;
+
+		nrf24_message_slot_t *slot = findSlot(framePipe, tag);
+
+		if (index == 0)
+		{
+			if (last)
+			{
+				// message fits in a single fragment, skip reassembly
+				if (slot) slot->active = false;
+
+				memcpy(buf, payload, bufferSize < length ? bufferSize : length);
+				if (pipe) *pipe = framePipe;
+
+				return length;
+			}
+
+			// start of a new message. If the sender is retrying a message we're already working on just start over
+			if (!slot) slot = allocateSlot(framePipe);
+
+			slot->active = true;
+			slot->pipe = framePipe;
+			slot->tag = tag;
+			slot->nextIndex = 0;
+			slot->length = 0;
+		}
+		else
+		{
+			// missed the start of this message
+			if (!slot) continue;
+
+			if (index != (slot->nextIndex & NRF24_MESSAGE_INDEX))
+			{
+				// a lost ACK makes the sender send the previous fragment again, ignore it
+				// anything else means we lost a fragment and the message is useless
+				if (index != ((slot->nextIndex - 1) & NRF24_MESSAGE_INDEX)) slot->active = false;
+				continue;
+			}
+		}
+
+		// doesn't fit in the slot
+		if (slot->length + length > slotSize)
+		{
+			slot->active = false;
+			continue;
+		}
+
+		memcpy(slotData(slot) + slot->length, payload, length);
+		slot->length += length;
+		slot->nextIndex++;
+		slot->age = clock++;
+
+		if (last)
+		{
+			slot->active = false;
+
+			memcpy(buf, slotData(slot), bufferSize < slot->length ? bufferSize : slot->length);
+			if (pipe) *pipe = framePipe;
+
+			return slot->length;
+		}
+	}
+
+	return 0;
+}
+
+/*********************************************************/
+
+uint16_t NRF24Messenger::getMaxMessageSize()
+{
+	return slotSize;
+}
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+bool NRF24Messenger::transmitMessage(uint8_t targetAddress, uint8_t *data, uint16_t length, bool broadcast)
+{
+	if (length == 0) return false;
+
+	uint8_t tag = (nextTag++ & 0x3) << NRF24_MESSAGE_TAG_SHIFT;
+	uint8_t index = 0;
+
+	uint8_t frame[32];
+
+	while (length)
+	{
+		uint8_t size = length > NRF24_MESSAGE_FRAGMENT_SIZE ? NRF24_MESSAGE_FRAGMENT_SIZE : length;
+		length -= size;
+
+		frame[0] = tag | (index++ & NRF24_MESSAGE_INDEX);
+		if (length == 0) frame[0] |= NRF24_MESSAGE_LAST;
+
+		memcpy(frame + 1, data, size);
+		data += size;
+
+		bool sent = broadcast ? radio.broadcast(frame, size + 1) : radio.send(targetAddress, frame, size + 1);
+		if (!sent) return false;
+	}
+
+	return true;
+}
+
+/*********************************************************/
+
+nrf24_message_slot_t *NRF24Messenger::findSlot(uint8_t pipe, uint8_t tag)
+{
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		if (slots[i].active && slots[i].pipe == pipe && slots[i].tag == tag) return &slots[i];
+	}
+
+	return NULL;
+}
+
+/*********************************************************/
+
+nrf24_message_slot_t *NRF24Messenger::allocateSlot(uint8_t pipe)
+{
+	nrf24_message_slot_t *freeSlot = NULL;
+	nrf24_message_slot_t *oldest = NULL;
+	nrf24_message_slot_t *oldestOfPipe = NULL;
+	uint8_t usedByPipe = 0;
+
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		nrf24_message_slot_t *slot = &slots[i];
+
+		if (!slot->active)
+		{
+			if (!freeSlot) freeSlot = slot;
+			continue;
+		}
+
+		// age is a wrapping counter so compare distances
+		if (!oldest || (uint8_t)(clock - slot->age) > (uint8_t)(clock - oldest->age)) oldest = slot;
+
+		if (slot->pipe == pipe)
+		{
+			++usedByPipe;
+			if (!oldestOfPipe || (uint8_t)(clock - slot->age) > (uint8_t)(clock - oldestOfPipe->age)) oldestOfPipe = slot;
+		}
+	}
+
+	// drop an unfinished message rather than letting one pipe take over all slots
+	if (usedByPipe >= maxPerPipe) return oldestOfPipe;
+
+	if (freeSlot) return freeSlot;
+
+	return oldest;
+}
+
+/*********************************************************/
+
+uint8_t *NRF24Messenger::slotData(nrf24_message_slot_t *slot)
+{
+	return buffer + (slot - slots) * slotSize;
+}
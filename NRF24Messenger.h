@@ -0,0 +1,71 @@
+#ifndef NRF24MESSENGER_H_
+#define NRF24MESSENGER_H_
+
+#include "NRF24.h"
+
+// Maximum number of messages that can be reassembled at the same time
+#ifndef NRF24_MESSAGE_MAX_SLOTS
+#define NRF24_MESSAGE_MAX_SLOTS 4
+#endif
+
+// Every fragment starts with a single header byte, the remaining 31 bytes are message data
+//   bits 7-6: message tag, increments with every message so a new message can be told apart from an old one
+//   bit 5:    set on the last fragment of a message
+//   bits 4-0: fragment index. Wraps around, it's only used to detect lost and duplicated fragments
+#define NRF24_MESSAGE_TAG_SHIFT		6
+#define NRF24_MESSAGE_LAST			0x20
+#define NRF24_MESSAGE_INDEX			0x1F
+#define NRF24_MESSAGE_FRAGMENT_SIZE	31
+
+typedef struct
+{
+	bool active;
+	uint8_t pipe;
+	uint8_t tag;
+	uint8_t nextIndex;
+	uint8_t age;
+	uint16_t length;
+} nrf24_message_slot_t;
+
+// Sends and receives messages larger than 32 bytes by splitting them into fragments
+// Fragments from the same pipe are expected to come from a single sender, as is the case when
+// using listenToAddress() for each sender. Interleaved messages from several senders on pipe 0 get dropped
+class NRF24Messenger
+{
+	public:
+		// buffer is split evenly into numSlots reassembly slots. The slot size is the largest message that can be received
+		// maxPerPipe limits how many slots the messages from a single pipe can take up at the same time (max 4)
+		NRF24Messenger(NRF24 &radio, uint8_t *buffer, uint16_t bufferSize, uint8_t numSlots = 1, uint8_t maxPerPipe = 1);
+
+		// Split data into fragments and transmit them with send() or broadcast()
+		// returns false if a fragment couldn't be sent, the receiver drops the partial message
+		bool sendMessage(uint8_t targetAddress, uint8_t *data, uint16_t length);
+		bool broadcastMessage(uint8_t *data, uint16_t length);
+
+		// Reads fragments from the radio until a message is complete
+		// returns the message length or 0 if no message is complete yet. Works like read() if the buffer is too small
+		uint16_t readMessage(uint8_t *buf, uint16_t bufferSize, uint8_t *pipe = NULL);
+
+		uint16_t getMaxMessageSize();
+
+	private:
+		bool transmitMessage(uint8_t targetAddress, uint8_t *data, uint16_t length, bool broadcast);
+
+		nrf24_message_slot_t *findSlot(uint8_t pipe, uint8_t tag);
+		nrf24_message_slot_t *allocateSlot(uint8_t pipe);
+		uint8_t *slotData(nrf24_message_slot_t *slot);
+
+		NRF24 &radio;
+
+		uint8_t *buffer;
+		uint16_t slotSize;
+		uint8_t numSlots;
+		uint8_t maxPerPipe;
+
+		nrf24_message_slot_t slots[NRF24_MESSAGE_MAX_SLOTS];
+		uint8_t clock;
+
+		uint8_t nextTag;
+};
+
+#endif // NRF24MESSENGER_H_
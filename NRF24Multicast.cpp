@@ -0,0 +1,348 @@
+#include "NRF24Multicast.h"
+
+// repair rounds before the sender gives up on a node that keeps NACKing
+static const uint8_t maxRounds = 16;
+
+/*********************************************************
+ *
+ * PUBLIC
+ *
+ *********************************************************/
+
+NRF24Multicast::NRF24Multicast(NRF24 &_radio, uint8_t _group)
+	: radio(_radio)
+{
+	group = _group;
+	groupPipe = -1;
+	window = 20;
+	quietPollsNeeded = 3;
+
+	state = NRF24_MULTICAST_IDLE;
+	message = NULL;
+	messageLength = 0;
+	numPackets = 0;
+	session = 0;
+	sessionStarted = false;
+	polling = false;
+
+	dataHandler = NULL;
+	completeHandler = NULL;
+	receiving = false;
+	nackPending = false;
+}
+
+/*********************************************************/
+
+bool NRF24Multicast::begin()
+{
+	int8_t listener = radio.listenToAddress(group);
+	if (listener < 0) return false;
+
+	groupPipe = listener + 1;
+	return true;
+}
+
+/*********************************************************/
+
+bool NRF24Multicast::push(const uint8_t *data, uint16_t length)
+{
+	if (state == NRF24_MULTICAST_SENDING) return false;
+	if (length == 0 || length > NRF24_MULTICAST_MAX_LENGTH) return false;
+
+	// receivers that finished the previous session ignore it, after a restart we shouldn't start with the same one
+	if (!sessionStarted) session = micros();
+	sessionStarted = true;
+	++session;
+
+	message = data;
+	messageLength = length;
+	numPackets = (length + NRF24_MULTICAST_DATA_SIZE - 1) / NRF24_MULTICAST_DATA_SIZE;
+
+	memset(toSend, 0, sizeof(toSend));
+	for (uint8_t i = 0; i < numPackets; i++) toSend[i >> 3] |= 1 << (i & 7);
+
+	polling = false;
+	quietPolls = 0;
+	rounds = 0;
+	state = NRF24_MULTICAST_SENDING;
+
+	return true;
+}
+
+/*********************************************************/
+
+nrf24_multicast_state_e NRF24Multicast::getState()
+{
+	return state;
+}
+
+/*********************************************************/
+
+void NRF24Multicast::setRepairWindow(uint8_t ms, uint8_t quietPolls)
+{
+	window = ms ? ms : 1;
+	quietPollsNeeded = quietPolls ? quietPolls : 1;
+}
+
+/*********************************************************/
+
+void NRF24Multicast::onData(nrf24_multicast_data_handler_t handler)
+{
+	dataHandler = handler;
+}
+
+/*********************************************************/
+
+void NRF24Multicast::onComplete(nrf24_multicast_complete_handler_t handler)
+{
+	completeHandler = handler;
+}
+
+/*********************************************************/
+
+void NRF24Multicast::poll()
+{
+	uint8_t packet[32];
+	uint8_t length;
+	uint8_t pipe;
+
+	while ((length = radio.available(&pipe)))
+	{
+		// someone else's, it's left for available() and read()
+		if (pipe != groupPipe) break;
+
+		radio.read(packet, sizeof(packet));
+		if (length < NRF24_MULTICAST_HEADER_SIZE || length > sizeof(packet)) continue;
+
+		handlePacket(packet, length);
+	}
+
+	if (nackPending && (int32_t)(millis() - nackAt) >= 0)
+	{
+		nackPending = false;
+		sendNack();
+	}
+
+	if (state == NRF24_MULTICAST_SENDING) pollSender();
+}
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+void NRF24Multicast::handlePacket(uint8_t *packet, uint8_t length)
+{
+	// nothing can be missing from a message with more packets than a NACK can hold
+	if (packet[3] == 0 || packet[3] > NRF24_MULTICAST_MAX_PACKETS) return;
+
+	switch (packet[0])
+	{
+		case NRF24_MULTICAST_DATA:
+			handleData(packet, length);
+			break;
+
+		case NRF24_MULTICAST_POLL:
+			handlePoll(packet);
+			break;
+
+		case NRF24_MULTICAST_NACK:
+			handleNack(packet, length);
+			break;
+	}
+}
+
+/*********************************************************/
+
+void NRF24Multicast::handleData(uint8_t *packet, uint8_t length)
+{
+	uint8_t number = packet[2];
+	if (number >= packet[3]) return;
+
+	if (!receiving || packet[1] != rxSession) startSession(packet[1], packet[3]);
+
+	uint8_t bit = 1 << (number & 7);
+	if (received[number >> 3] & bit) return;
+
+	received[number >> 3] |= bit;
+	++numReceived;
+
+	length -= NRF24_MULTICAST_HEADER_SIZE;
+	if (number == rxPackets - 1) lastLength = length;
+
+	if (dataHandler) dataHandler(number * NRF24_MULTICAST_DATA_SIZE, packet + NRF24_MULTICAST_HEADER_SIZE, length);
+
+	if (numReceived == rxPackets)
+	{
+		nackPending = false;
+		if (completeHandler) completeHandler((rxPackets - 1) * NRF24_MULTICAST_DATA_SIZE + lastLength);
+	}
+}
+
+/*********************************************************/
+
+void NRF24Multicast::handlePoll(uint8_t *packet)
+{
+	// missed all the data
+	if (!receiving || packet[1] != rxSession) startSession(packet[1], packet[3]);
+
+	if (numReceived == rxPackets) return;
+
+	// Spread the NACKs over the window. The first one usually covers what the others are missing too,
+	// they hear it and keep quiet
+	// random() isn't seeded, nodes running the same firmware would all pick the same delay without the address
+	uint8_t spread = packet[2] > 1 ? packet[2] * 3 / 4 : 1;
+	memset(covered, 0, sizeof(covered));
+	nackAt = millis() + (random(spread) + radio.getAddress()) % spread;
+	nackPending = true;
+}
+
+/*********************************************************/
+
+void NRF24Multicast::handleNack(uint8_t *packet, uint8_t length)
+{
+	// the sender adds it to what it's going to repeat
+	if (state == NRF24_MULTICAST_SENDING && polling && packet[1] == session)
+	{
+		for (uint8_t i = 0; i + NRF24_MULTICAST_HEADER_SIZE < length && i < (numPackets + 7) / 8; i++)
+		{
+			toSend[i] |= packet[NRF24_MULTICAST_HEADER_SIZE + i];
+		}
+		return;
+	}
+
+	// another receiver of the same message
+	if (!receiving || packet[1] != rxSession) return;
+
+	bool allCovered = true;
+	for (uint8_t i = 0; i < (rxPackets + 7) / 8; i++)
+	{
+		if (i + NRF24_MULTICAST_HEADER_SIZE < length) covered[i] |= packet[NRF24_MULTICAST_HEADER_SIZE + i];
+
+		uint8_t missing = ~received[i];
+		if (i == rxPackets >> 3) missing &= (1 << (rxPackets & 7)) - 1;
+		if (missing & ~covered[i]) allCovered = false;
+	}
+
+	if (allCovered) nackPending = false;
+}
+
+/*********************************************************/
+
+void NRF24Multicast::startSession(uint8_t number, uint8_t count)
+{
+	receiving = true;
+	rxSession = number;
+	rxPackets = count;
+	numReceived = 0;
+	lastLength = 0;
+	nackPending = false;
+	memset(received, 0, sizeof(received));
+	memset(covered, 0, sizeof(covered));
+}
+
+/*********************************************************/
+
+void NRF24Multicast::pollSender()
+{
+	if (!polling)
+	{
+		// the next packet still to go out this round
+		for (uint8_t i = 0; i < numPackets; i++)
+		{
+			uint8_t bit = 1 << (i & 7);
+			if (!(toSend[i >> 3] & bit)) continue;
+
+			toSend[i >> 3] &= ~bit;
+			sendPacket(i);
+			return;
+		}
+
+		sendPoll();
+		return;
+	}
+
+	if (millis() - polledAt < window) return;
+
+	bool nacked = false;
+	for (uint8_t i = 0; i < sizeof(toSend); i++)
+	{
+		if (toSend[i]) nacked = true;
+	}
+
+	if (!nacked)
+	{
+		if (++quietPolls >= quietPollsNeeded) state = NRF24_MULTICAST_DONE;
+		else sendPoll();
+		return;
+	}
+
+	// repeat the union of all NACKs
+	quietPolls = 0;
+	polling = false;
+	if (++rounds > maxRounds) state = NRF24_MULTICAST_FAILED;
+}
+
+/*********************************************************/
+
+void NRF24Multicast::sendPacket(uint8_t number)
+{
+	uint16_t offset = number * NRF24_MULTICAST_DATA_SIZE;
+	uint8_t length = messageLength - offset > NRF24_MULTICAST_DATA_SIZE ? NRF24_MULTICAST_DATA_SIZE : messageLength - offset;
+
+	uint8_t packet[32];
+	packet[0] = NRF24_MULTICAST_DATA;
+	packet[1] = session;
+	packet[2] = number;
+	packet[3] = numPackets;
+	memcpy(packet + NRF24_MULTICAST_HEADER_SIZE, message + offset, length);
+
+	transmit(packet, length + NRF24_MULTICAST_HEADER_SIZE);
+}
+
+/*********************************************************/
+
+void NRF24Multicast::sendPoll()
+{
+	uint8_t packet[NRF24_MULTICAST_HEADER_SIZE] = { NRF24_MULTICAST_POLL, session, window, numPackets };
+	transmit(packet, sizeof(packet));
+
+	polling = true;
+	polledAt = millis();
+}
+
+/*********************************************************/
+
+void NRF24Multicast::sendNack()
+{
+	uint8_t packet[32];
+	uint8_t size = (rxPackets + 7) / 8;
+
+	packet[0] = NRF24_MULTICAST_NACK;
+	packet[1] = rxSession;
+	packet[2] = 0;
+	packet[3] = rxPackets;
+
+	for (uint8_t i = 0; i < size; i++)
+	{
+		uint8_t missing = ~received[i];
+		if (i == rxPackets >> 3) missing &= (1 << (rxPackets & 7)) - 1;
+		packet[NRF24_MULTICAST_HEADER_SIZE + i] = missing;
+	}
+
+	transmit(packet, size + NRF24_MULTICAST_HEADER_SIZE);
+}
+
+/*********************************************************/
+
+bool NRF24Multicast::transmit(uint8_t *packet, uint8_t length)
+{
+	// like broadcast() but to the group address, nobody ACKs
+	bool ack = radio.getACKEnabled();
+	radio.setACKEnabled(false);
+	bool sent = radio.send(group, packet, length);
+	radio.setACKEnabled(ack);
+
+	return sent;
+}
@@ -0,0 +1,116 @@
+#ifndef NRF24MULTICAST_H_
+#define NRF24MULTICAST_H_
+
+#include "NRF24.h"
+
+// Every packet starts with a 4 byte header, the remaining 28 bytes are data
+//   data:  kind (NRF24_MULTICAST_DATA), session, packet number, number of packets
+//   polls: kind (NRF24_MULTICAST_POLL), session, repair window in mS, number of packets. No data
+//   NACKs: kind (NRF24_MULTICAST_NACK), session, 0, number of packets. The data is a bit per packet, set if it's missing
+#define NRF24_MULTICAST_HEADER_SIZE	4
+#define NRF24_MULTICAST_DATA_SIZE	28
+
+#define NRF24_MULTICAST_DATA		0xA0
+#define NRF24_MULTICAST_POLL		0xA1
+#define NRF24_MULTICAST_NACK		0xA2
+
+// a NACK has room for a bit per packet of the largest message
+#define NRF24_MULTICAST_MAX_PACKETS	(NRF24_MULTICAST_DATA_SIZE * 8)
+#define NRF24_MULTICAST_MAX_LENGTH	(NRF24_MULTICAST_MAX_PACKETS * NRF24_MULTICAST_DATA_SIZE)
+
+typedef enum
+{
+	NRF24_MULTICAST_IDLE = 0,
+	NRF24_MULTICAST_SENDING,
+	NRF24_MULTICAST_DONE,		// a few polls in a row got no NACKs
+	NRF24_MULTICAST_FAILED		// still NACKed after the last repair round
+} nrf24_multicast_state_e;
+
+// see onData(), offset is where the data goes in the message. data is only valid during the call
+typedef void (*nrf24_multicast_data_handler_t)(uint16_t offset, uint8_t *data, uint8_t length);
+
+// see onComplete(), called once all packets of a message are in
+typedef void (*nrf24_multicast_complete_handler_t)(uint16_t length);
+
+// Reliable one-to-many transfers, for pushing firmware or configuration to a lot of nodes at once
+// The sender sends the message to a group address without ACKs, numbered packets of 28 bytes, then polls the group.
+// Receivers that are missing packets wait a random time within the repair window and send a NACK with a bit per
+// missing packet, unless they overheard NACKs for everything they're missing already. The sender sends the packets
+// of all NACKs once more and polls again, until nobody is missing anything. Airtime grows with the losses, not with
+// the number of receivers
+// The sender finishes once a few polls in a row stay unanswered, it can't tell if a node is out of range altogether
+// All packets to the group address are expected to be multicast packets. poll() stops at a packet that came in on
+// another address and leaves it for available() and read()
+class NRF24Multicast
+{
+	public:
+		NRF24Multicast(NRF24 &radio, uint8_t group);
+
+		// Listens to the group address (the sender does too, for NACKs), returns false when there's no pipe left
+		bool begin();
+
+		// sender. data has to stay around until the state isn't NRF24_MULTICAST_SENDING anymore
+		// returns false when still busy or length is over NRF24_MULTICAST_MAX_LENGTH
+		bool push(const uint8_t *data, uint16_t length);
+		nrf24_multicast_state_e getState();
+
+		// How long receivers have to NACK after a poll, the more of them the longer this should be (20mS by default)
+		// The sender is done after quietPolls polls in a row without NACKs. A poll or NACK that gets lost looks the
+		// same, with a lot of losses more of them make it less likely that a node is left with gaps
+		void setRepairWindow(uint8_t ms, uint8_t quietPolls = 3);
+
+		// receiver
+		void onData(nrf24_multicast_data_handler_t handler);
+		void onComplete(nrf24_multicast_complete_handler_t handler);
+
+		// Does all the work, call from loop(). The sender sends a packet at a time
+		void poll();
+
+	private:
+		void handlePacket(uint8_t *packet, uint8_t length);
+		void handleData(uint8_t *packet, uint8_t length);
+		void handlePoll(uint8_t *packet);
+		void handleNack(uint8_t *packet, uint8_t length);
+		void startSession(uint8_t session, uint8_t count);
+
+		void pollSender();
+		void sendPacket(uint8_t number);
+		void sendPoll();
+		void sendNack();
+		bool transmit(uint8_t *packet, uint8_t length);
+
+		NRF24 &radio;
+
+		uint8_t group;
+		int8_t groupPipe;
+		uint8_t window;
+		uint8_t quietPollsNeeded;
+
+		// sender
+		nrf24_multicast_state_e state;
+		const uint8_t *message;
+		uint16_t messageLength;
+		uint8_t numPackets;
+		uint8_t session;
+		bool sessionStarted;
+		uint8_t toSend[NRF24_MULTICAST_DATA_SIZE];	// a bit per packet, NACKed packets are added while polling
+		bool polling;
+		uint32_t polledAt;
+		uint8_t quietPolls;
+		uint8_t rounds;
+
+		// receiver
+		nrf24_multicast_data_handler_t dataHandler;
+		nrf24_multicast_complete_handler_t completeHandler;
+		bool receiving;
+		uint8_t rxSession;
+		uint8_t rxPackets;
+		uint8_t received[NRF24_MULTICAST_DATA_SIZE];	// a bit per packet
+		uint8_t numReceived;
+		uint8_t lastLength;
+		uint8_t covered[NRF24_MULTICAST_DATA_SIZE];		// what other receivers NACKed since the poll
+		bool nackPending;
+		uint32_t nackAt;
+};
+
+#endif // NRF24MULTICAST_H_
@@ -0,0 +1,171 @@
+#include "NRF24Mux.h"
+
+/*********************************************************
+ *
+ * PUBLIC
+ *
+ *********************************************************/
+
+NRF24Mux::NRF24Mux(NRF24 &_radio, uint16_t *_table, uint16_t _tableSize)
+	: radio(_radio)
+{
+	table = _table;
+	tableSize = _tableSize;
+	numEndpoints = 0;
+
+	for (uint16_t i = 0; i < tableSize; i++)
+	{
+		table[i] = NRF24_MUX_NO_ENDPOINT;
+	}
+}
+
+/*********************************************************/
+
+bool NRF24Mux::listen(uint16_t endpoint)
+{
+	if (endpoint >= NRF24_MUX_NO_ENDPOINT) return false;
+	if (find(endpoint) >= 0) return true;
+
+	// always keep a free entry, that's where a lookup stops
+	if (numEndpoints + 1 >= tableSize) return false;
+
+	// linear probing, first free entry from where it belongs
+	uint16_t i = home(endpoint);
+	while (table[i] != NRF24_MUX_NO_ENDPOINT)
+	{
+		if (++i == tableSize) i = 0;
+	}
+
+	table[i] = endpoint;
+	++numEndpoints;
+
+	return true;
+}
+
+/*********************************************************/
+
+bool NRF24Mux::unlisten(uint16_t endpoint)
+{
+	int16_t found = find(endpoint);
+	if (found < 0) return false;
+
+	uint16_t i = found;
+	table[i] = NRF24_MUX_NO_ENDPOINT;
+	--numEndpoints;
+
+	// Move back entries further along the run that can take the freed spot, otherwise a lookup
+	// for them would stop at the gap. Saves having to mark deleted entries
+	uint16_t j = i;
+	while (true)
+	{
+		if (++j == tableSize) j = 0;
+		if (table[j] == NRF24_MUX_NO_ENDPOINT) break;
+
+		uint16_t h = home(table[j]);
+
+		// the entry at j stays put if its home lies (cyclically) after the gap
+		bool stays = (i <= j) ? (i < h && h <= j) : (i < h || h <= j);
+		if (stays) continue;
+
+		table[i] = table[j];
+		table[j] = NRF24_MUX_NO_ENDPOINT;
+		i = j;
+	}
+
+	return true;
+}
+
+/*********************************************************/
+
+bool NRF24Mux::isListening(uint16_t endpoint)
+{
+	return endpoint == NRF24_MUX_BROADCAST || find(endpoint) >= 0;
+}
+
+/*********************************************************/
+
+bool NRF24Mux::send(uint8_t node, uint16_t to, uint16_t from, uint8_t *data, uint8_t length)
+{
+	uint8_t packet[32];
+	return radio.send(node, packet, buildPacket(packet, to, from, data, length));
+}
+
+/*********************************************************/
+
+bool NRF24Mux::broadcast(uint16_t to, uint16_t from, uint8_t *data, uint8_t length)
+{
+	uint8_t packet[32];
+	return radio.broadcast(packet, buildPacket(packet, to, from, data, length));
+}
+
+/*********************************************************/
+
+uint8_t NRF24Mux::read(uint8_t *buf, uint8_t bufferSize, uint16_t *to, uint16_t *from)
+{
+	uint8_t packet[32];
+	uint8_t length;
+
+	while ((length = radio.receive(packet, sizeof(packet))))
+	{
+		// not one of ours
+		if (length < NRF24_MUX_HEADER_SIZE || length > sizeof(packet)) continue;
+
+		uint16_t destination = packet[0] | (packet[1] << 8);
+		if (!isListening(destination)) continue;
+
+		if (to) *to = destination;
+		if (from) *from = packet[2] | (packet[3] << 8);
+
+		length -= NRF24_MUX_HEADER_SIZE;
+		if (bufferSize > length) bufferSize = length;
+		memcpy(buf, packet + NRF24_MUX_HEADER_SIZE, bufferSize);
+
+		return length;
+	}
+
+	return 0;
+}
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+uint8_t NRF24Mux::buildPacket(uint8_t *packet, uint16_t to, uint16_t from, uint8_t *data, uint8_t length)
+{
+	if (length > NRF24_MUX_DATA_SIZE) length = NRF24_MUX_DATA_SIZE;
+
+	packet[0] = to & 0xFF;
+	packet[1] = to >> 8;
+	packet[2] = from & 0xFF;
+	packet[3] = from >> 8;
+	memcpy(packet + NRF24_MUX_HEADER_SIZE, data, length);
+
+	return length + NRF24_MUX_HEADER_SIZE;
+}
+
+/*********************************************************/
+
+uint16_t NRF24Mux::home(uint16_t endpoint)
+{
+	// endpoints tend to be numbered in sequence, mix the bits so they don't all end up in one run
+	uint16_t hash = endpoint * 40503u;
+	return (hash ^ (hash >> 8)) % tableSize;
+}
+
+/*********************************************************/
+
+int16_t NRF24Mux::find(uint16_t endpoint)
+{
+	if (!tableSize) return -1;
+
+	uint16_t i = home(endpoint);
+	while (table[i] != NRF24_MUX_NO_ENDPOINT)
+	{
+		if (table[i] == endpoint) return i;
+		if (++i == tableSize) i = 0;
+	}
+
+	return -1;
+}
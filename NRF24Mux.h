@@ -0,0 +1,53 @@
+#ifndef NRF24MUX_H_
+#define NRF24MUX_H_
+
+#include "NRF24.h"
+
+// Every packet starts with a 4 byte header, the remaining 28 bytes are data
+//   bytes 0-1: destination endpoint, least significant byte first
+//   bytes 2-3: source endpoint
+#define NRF24_MUX_HEADER_SIZE	4
+#define NRF24_MUX_DATA_SIZE		28
+
+// Destination that every node accepts
+#define NRF24_MUX_BROADCAST		0xFFFF
+
+// Marks a free entry in the subscription table, can't be used as an endpoint
+#define NRF24_MUX_NO_ENDPOINT	0xFFFE
+
+// Logical endpoints on top of the radio addresses. A node has one radio address (or a few, with listenToAddress())
+// but can subscribe to as many endpoints as its table has room for. Endpoints are looked up in a hash table so it
+// doesn't matter how many there are. Addresses that need to be fast can still get a pipe of their own
+// All packets to the node's addresses are expected to be endpoint packets
+class NRF24Mux
+{
+	public:
+		// table holds the subscriptions, keep it a bit larger (~25%) than the number of endpoints for quick lookups
+		NRF24Mux(NRF24 &radio, uint16_t *table, uint16_t tableSize);
+
+		// returns false when the table is full
+		bool listen(uint16_t endpoint);
+		bool unlisten(uint16_t endpoint);
+		bool isListening(uint16_t endpoint);
+
+		// node is the radio address of the node that listens to the destination endpoint
+		bool send(uint8_t node, uint16_t to, uint16_t from, uint8_t *data, uint8_t length);
+		bool broadcast(uint16_t to, uint16_t from, uint8_t *data, uint8_t length);
+
+		// Reads packets from the radio until there's one for an endpoint we listen to, others are dropped
+		// returns the data size, 0 if there's nothing. to and from are set to the endpoints from the header
+		uint8_t read(uint8_t *buf, uint8_t bufferSize, uint16_t *to = NULL, uint16_t *from = NULL);
+
+	private:
+		uint8_t buildPacket(uint8_t *packet, uint16_t to, uint16_t from, uint8_t *data, uint8_t length);
+		uint16_t home(uint16_t endpoint);
+		int16_t find(uint16_t endpoint);
+
+		NRF24 &radio;
+
+		uint16_t *table;
+		uint16_t tableSize;
+		uint16_t numEndpoints;
+};
+
+#endif // NRF24MUX_H_
@@ -0,0 +1,122 @@
+#include "NRF24PacketReader.h"
+
+NRF24PacketReader::NRF24PacketReader(NRF24 &_radio)
+	: radio(_radio)
+{
+	packet = NULL;
+	packetLength = 0;
+	packetPipe = 0;
+	position = 0;
+	open = false;
+
+	if (radio.rxBuffer)
+	{
+		packetLength = radio.available(&packetPipe);
+		if (!packetLength) return;
+
+		// the slot stays ours until end()
+		packet = &radio.rxBuffer[radio.rxHead];
+		open = true;
+		return;
+	}
+
+	packetLength = radio.nextPacket(&packetPipe);
+	if (!packetLength) return;
+
+	// the payload is clocked out as it's asked for
+	radio.beginCommand();
+	radio.transport->transfer(R_RX_PAYLOAD);
+
+	// the length from nextPacket() is without the tag of setSequenceTagging()
+	if (radio.tagSize()) radio.transport->transfer(NULL, NULL, radio.tagSize());
+	open = true;
+}
+
+/*********************************************************/
+
+NRF24PacketReader::~NRF24PacketReader()
+{
+	end();
+}
+
+/*********************************************************/
+
+uint8_t NRF24PacketReader::length()
+{
+	return packetLength;
+}
+
+/*********************************************************/
+
+uint8_t NRF24PacketReader::pipe()
+{
+	return packetPipe;
+}
+
+/*********************************************************/
+
+uint8_t NRF24PacketReader::remaining()
+{
+	return open ? packetLength - position : 0;
+}
+
+/*********************************************************/
+
+int NRF24PacketReader::read()
+{
+	if (!remaining()) return -1;
+
+	if (packet) return packet->data[position++];
+
+	++position;
+	return radio.transport->transfer(NOP);
+}
+
+/*********************************************************/
+
+uint8_t NRF24PacketReader::read(uint8_t *buf, uint8_t size)
+{
+	if (size > remaining()) size = remaining();
+
+	if (packet)
+	{
+		memcpy(buf, packet->data + position, size);
+	}
+	else
+	{
+		radio.transport->transfer(NULL, buf, size);
+	}
+
+	position += size;
+
+	return size;
+}
+
+/*********************************************************/
+
+void NRF24PacketReader::skip(uint8_t count)
+{
+	if (count > remaining()) count = remaining();
+
+	// from SPI the bytes still have to be clocked out to get past them
+	if (!packet) radio.transport->transfer(NULL, NULL, count);
+
+	position += count;
+}
+
+/*********************************************************/
+
+void NRF24PacketReader::end()
+{
+	if (!open) return;
+	open = false;
+
+	if (packet)
+	{
+		radio.popRX();
+		return;
+	}
+
+	radio.endCommand();
+	radio.packetRead();
+}
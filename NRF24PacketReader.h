@@ -0,0 +1,45 @@
+#ifndef NRF24PACKETREADER_H_
+#define NRF24PACKETREADER_H_
+
+#include "NRF24.h"
+
+// Hands out the next received packet a byte at a time, straight from SPI, for parsers that work through
+// a packet field by field and don't need it in a buffer. CSN stays low from when the reader is created
+// until it goes out of scope (or end() is called), so keep it short and don't use the radio in between.
+// The packet is gone afterwards whether it was read to the end or not
+// With an RX buffer (see NRF24::setRXBuffer()) the bytes come from there instead
+//
+//	{
+//		NRF24PacketReader packet(radio);
+//		if (packet.length())
+//		{
+//			uint8_t type = packet.read();
+//			...
+//		}
+//	}
+class NRF24PacketReader
+{
+	public:
+		NRF24PacketReader(NRF24 &radio);
+		~NRF24PacketReader();
+
+		uint8_t length();		// 0 if there was no packet
+		uint8_t pipe();			// the listener from available()
+		uint8_t remaining();
+
+		int read();				// next byte, -1 past the end
+		uint8_t read(uint8_t *buf, uint8_t size);
+		void skip(uint8_t count);
+
+		void end();				// release the bus early, the rest of the packet is dropped
+
+	private:
+		NRF24 &radio;
+		nrf24_packet_t *packet;	// in the RX buffer, NULL when reading from SPI
+		uint8_t packetLength;
+		uint8_t packetPipe;
+		uint8_t position;
+		bool open;
+};
+
+#endif // NRF24PACKETREADER_H_
@@ -0,0 +1,211 @@
+#include "NRF24PubSub.h"
+
+// copies of a message go out back to back, a sequence number seen longer ago than this is a new message
+// (the publisher may have restarted and counts from 0 again)
+static const uint16_t recentLifetime = 100;	// mS
+
+/*********************************************************
+ *
+ * PUBLIC
+ *
+ *********************************************************/
+
+NRF24PubSub::NRF24PubSub(NRF24 &_radio, uint8_t _bus, uint8_t *_topics, uint16_t _numTopics)
+	: radio(_radio)
+{
+	bus = _bus;
+	busPipe = -1;
+
+	topics = _topics;
+	numTopics = _numTopics;
+
+	repeats = 1;
+	sequence = 0;
+
+	recentHead = 0;
+	numRecent = 0;
+
+	handler = NULL;
+
+	unsubscribeAll();
+}
+
+/*********************************************************/
+
+bool NRF24PubSub::begin()
+{
+	if (bus == radio.getAddress())
+	{
+		busPipe = 0;
+		radio.startListening();
+		return true;
+	}
+
+	int8_t listener = radio.listenToAddress(bus);
+	if (listener < 0) return false;
+
+	busPipe = listener + 1;
+	return true;
+}
+
+/*********************************************************/
+
+bool NRF24PubSub::subscribe(uint16_t topic)
+{
+	if (topic >= numTopics) return false;
+
+	topics[topic >> 3] |= 1 << (topic & 7);
+	return true;
+}
+
+/*********************************************************/
+
+bool NRF24PubSub::unsubscribe(uint16_t topic)
+{
+	if (topic >= numTopics) return false;
+
+	topics[topic >> 3] &= ~(1 << (topic & 7));
+	return true;
+}
+
+/*********************************************************/
+
+bool NRF24PubSub::isSubscribed(uint16_t topic)
+{
+	if (topic >= numTopics) return false;
+
+	return topics[topic >> 3] & (1 << (topic & 7));
+}
+
+/*********************************************************/
+
+void NRF24PubSub::unsubscribeAll()
+{
+	if (topics) memset(topics, 0, (numTopics + 7) / 8);
+}
+
+/*********************************************************/
+
+void NRF24PubSub::setRepeats(uint8_t count)
+{
+	repeats = count ? count : 1;
+}
+
+/*********************************************************/
+
+bool NRF24PubSub::publish(uint16_t topic, uint8_t *data, uint8_t length)
+{
+	if (length > NRF24_PUBSUB_DATA_SIZE) length = NRF24_PUBSUB_DATA_SIZE;
+
+	uint8_t packet[32];
+	packet[0] = topic & 0xFF;
+	packet[1] = topic >> 8;
+	packet[2] = radio.getAddress();
+	packet[3] = sequence++;
+	memcpy(packet + NRF24_PUBSUB_HEADER_SIZE, data, length);
+
+	// like broadcast() but to the bus address. Nobody ACKs, there could be any number of subscribers
+	bool ack = radio.getACKEnabled();
+	radio.setACKEnabled(false);
+
+	bool sent = false;
+	for (uint8_t i = 0; i < repeats; i++)
+	{
+		if (radio.send(bus, packet, length + NRF24_PUBSUB_HEADER_SIZE)) sent = true;
+	}
+
+	radio.setACKEnabled(ack);
+
+	return sent;
+}
+
+/*********************************************************/
+
+uint8_t NRF24PubSub::read(uint8_t *buf, uint8_t bufferSize, uint16_t *topic, uint8_t *publisher)
+{
+	uint8_t packet[32];
+	uint8_t length = next(packet);
+	if (!length) return 0;
+
+	if (topic) *topic = packet[0] | (packet[1] << 8);
+	if (publisher) *publisher = packet[2];
+
+	length -= NRF24_PUBSUB_HEADER_SIZE;
+	if (bufferSize > length) bufferSize = length;
+	memcpy(buf, packet + NRF24_PUBSUB_HEADER_SIZE, bufferSize);
+
+	return length;
+}
+
+/*********************************************************/
+
+void NRF24PubSub::onMessage(nrf24_topic_handler_t _handler)
+{
+	handler = _handler;
+}
+
+/*********************************************************/
+
+void NRF24PubSub::poll()
+{
+	if (!handler) return;
+
+	uint8_t packet[32];
+	uint8_t length;
+
+	while ((length = next(packet)))
+	{
+		handler(packet[0] | (packet[1] << 8), packet[2], packet + NRF24_PUBSUB_HEADER_SIZE, length - NRF24_PUBSUB_HEADER_SIZE);
+	}
+}
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+uint8_t NRF24PubSub::next(uint8_t *packet)
+{
+	uint8_t length;
+	uint8_t pipe;
+
+	while ((length = radio.available(&pipe)))
+	{
+		// someone else's, it's left for available() and read()
+		if (pipe != busPipe) return 0;
+
+		radio.read(packet, 32);
+		if (length < NRF24_PUBSUB_HEADER_SIZE || length > 32) continue;
+
+		// a bit test, unwanted topics cost nothing more than reading them from the chip
+		if (!isSubscribed(packet[0] | (packet[1] << 8))) continue;
+
+		if (seen(packet[2], packet[3])) continue;
+
+		return length;
+	}
+
+	return 0;
+}
+
+/*********************************************************/
+
+bool NRF24PubSub::seen(uint8_t publisher, uint8_t number)
+{
+	uint16_t key = (publisher << 8) | number;
+	uint32_t now = millis();
+
+	for (uint8_t i = 0; i < numRecent; i++)
+	{
+		if (recent[i] == key && now - recentTime[i] < recentLifetime) return true;
+	}
+
+	// the oldest makes room
+	recent[recentHead] = key;
+	recentTime[recentHead] = now;
+	if (++recentHead == NRF24_PUBSUB_RECENT) recentHead = 0;
+	if (numRecent < NRF24_PUBSUB_RECENT) ++numRecent;
+
+	return false;
+}
@@ -0,0 +1,81 @@
+#ifndef NRF24PUBSUB_H_
+#define NRF24PUBSUB_H_
+
+#include "NRF24.h"
+
+// Every packet starts with a 4 byte header, the remaining 28 bytes are data
+//   bytes 0-1: topic, least significant byte first
+//   byte 2:    address of the publisher
+//   byte 3:    sequence number of the message, the same for all copies of it
+#define NRF24_PUBSUB_HEADER_SIZE	4
+#define NRF24_PUBSUB_DATA_SIZE		28
+
+// messages remembered to drop repeated copies
+#define NRF24_PUBSUB_RECENT			8
+
+// see onMessage(), data is only valid during the call
+typedef void (*nrf24_topic_handler_t)(uint16_t topic, uint8_t publisher, uint8_t *data, uint8_t length);
+
+// Topics on top of broadcasts. All publishers send to one bus address, so subscribers only need a single pipe no
+// matter how many publishers and topics there are. A subscriber keeps a bit per topic and drops the packets of
+// topics it isn't subscribed to before the application sees them
+// Like broadcast() nothing is ACKed. setRepeats() sends every message more than once, subscribers pass on only
+// the first copy that makes it
+// All packets to the bus address are expected to be topic packets
+class NRF24PubSub
+{
+	public:
+		// bus is the radio address messages are published to. topics has a bit per topic, (numTopics + 7) / 8
+		// bytes, topics from 0 to numTopics - 1 can be subscribed to. Nodes that only publish don't need it
+		NRF24PubSub(NRF24 &radio, uint8_t bus, uint8_t *topics = NULL, uint16_t numTopics = 0);
+
+		// Subscribers listen to the bus address, returns false when there's no pipe left
+		bool begin();
+
+		// returns false for topics outside the bitmap
+		bool subscribe(uint16_t topic);
+		bool unsubscribe(uint16_t topic);
+		bool isSubscribed(uint16_t topic);
+		void unsubscribeAll();
+
+		// every message goes out count times (1 by default). Each copy costs as much airtime as the first
+		void setRepeats(uint8_t count);
+
+		// up to NRF24_PUBSUB_DATA_SIZE bytes. returns false if none of the copies could be sent
+		bool publish(uint16_t topic, uint8_t *data, uint8_t length);
+
+		// Reads packets from the radio until there's a new one for a topic we're subscribed to, others are dropped
+		// returns the data size, 0 if there's nothing. topic and publisher are set from the header
+		// It stops at a packet that didn't come in on the bus address and leaves it for available() and read()
+		uint8_t read(uint8_t *buf, uint8_t bufferSize, uint16_t *topic = NULL, uint8_t *publisher = NULL);
+
+		// Have poll() pass messages to a handler instead of going through read(), call it from loop()
+		void onMessage(nrf24_topic_handler_t handler);
+		void poll();
+
+	private:
+		uint8_t next(uint8_t *packet);
+		bool seen(uint8_t publisher, uint8_t number);
+
+		NRF24 &radio;
+
+		uint8_t bus;
+		int8_t busPipe;
+
+		uint8_t *topics;
+		uint16_t numTopics;
+
+		uint8_t repeats;
+		uint8_t sequence;
+
+		// publisher << 8 | sequence of the last messages and millis() when they came in, oldest at recentHead once
+		// it's full
+		uint16_t recent[NRF24_PUBSUB_RECENT];
+		uint32_t recentTime[NRF24_PUBSUB_RECENT];
+		uint8_t recentHead;
+		uint8_t numRecent;
+
+		nrf24_topic_handler_t handler;
+};
+
+#endif // NRF24PUBSUB_H_
@@ -68,6 +68,7 @@
 #define TX_DS       0x20
 #define MAX_RT      0x10
 #define RX_P_NO     0x02
+#define RX_P_NO_MASK 0x0E // 3 bit pipe number, 7 when the RX FIFO is empty
 #define TX_FULL     0x01
 // OBSERVE_TX
 #define PLOS_CNT    0x10
@@ -0,0 +1,505 @@
+#include "NRF24Rpc.h"
+
+// nrf24_rpc_slot_t state
+static const uint8_t slotFree = 0;
+static const uint8_t callQueued = 1;	// request still has to go out (again)
+static const uint8_t callSent = 2;		// waiting for the reply
+static const uint8_t replyQueued = 3;	// reply that goes out as a packet of its own
+static const uint8_t replyForAck = 4;	// reply that didn't fit in the radio's response queue yet
+static const uint8_t replySent = 5;		// kept a little longer to answer the request again if it comes in twice
+
+// A client sends a request again when it didn't see the ACK, though it may have got there. Its reply is kept this
+// long to answer that without running the method twice. IDs come round again after 256 calls, it has to be shorter
+// than those take
+static const uint8_t duplicateWindow = 50;	// mS
+
+// NRF24Rpc::sending
+static const int8_t notSending = -1;
+static const int8_t sendingPoll = -2;
+
+/*********************************************************
+ *
+ * PUBLIC
+ *
+ *********************************************************/
+
+NRF24Rpc::NRF24Rpc(NRF24 &_radio, nrf24_rpc_slot_t *_slots, uint8_t _numSlots)
+	: radio(_radio)
+{
+	slots = _slots;
+	numSlots = _numSlots;
+
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		slots[i].state = slotFree;
+	}
+
+	methods = NULL;
+	numMethods = 0;
+	replyHandler = NULL;
+	nextId = 0;
+	sending = notSending;
+	lastSent = 0;
+	awaiting = -1;
+	awaitingSince = 0;
+	peerListening = 0;
+}
+
+/*********************************************************/
+
+bool NRF24Rpc::setMethods(nrf24_rpc_method_t *_methods, uint8_t _numMethods)
+{
+	// Replies wait for the client's next packet in the radio's response buffer. Written to the chip without one
+	// they'd be gone with our next transmission
+	if (!radio.getResponseDepth() && _numMethods) return false;
+
+	methods = _methods;
+	numMethods = _numMethods;
+	return true;
+}
+
+/*********************************************************/
+
+void NRF24Rpc::onReply(nrf24_rpc_reply_handler_t handler)
+{
+	replyHandler = handler;
+}
+
+/*********************************************************/
+
+int8_t NRF24Rpc::call(uint8_t server, uint8_t method, const uint8_t *data, uint8_t length, uint16_t timeout)
+{
+	int8_t call = freeSlot();
+	if (call < 0) return -1;
+
+	if (length > NRF24_RPC_DATA_SIZE) length = NRF24_RPC_DATA_SIZE;
+
+	// the ID is all that ties a reply to its call, skip the ones still in use
+	bool used = true;
+	while (used)
+	{
+		used = false;
+		for (uint8_t i = 0; i < numSlots; i++)
+		{
+			if ((slots[i].state == callQueued || slots[i].state == callSent) && slots[i].id == nextId)
+			{
+				used = true;
+				++nextId;
+				break;
+			}
+		}
+	}
+
+	nrf24_rpc_slot_t &slot = slots[call];
+	slot.state = callQueued;
+	slot.address = server;
+	slot.id = nextId++;
+	slot.method = method;
+	slot.more = false;
+	slot.length = length;
+	memcpy(slot.data, data, length);
+	slot.deadline = millis() + timeout;
+
+	return call;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Rpc::pending()
+{
+	uint8_t count = 0;
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		if (slots[i].state == callQueued || slots[i].state == callSent) ++count;
+	}
+	return count;
+}
+
+/*********************************************************/
+
+void NRF24Rpc::poll()
+{
+	// the radio can't do anything else while a transmission is pending
+	if (finishSend())
+	{
+		receive();
+		queueAckReplies();
+		checkDeadlines();
+		startSend();
+	}
+	else
+	{
+		checkDeadlines();
+	}
+}
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+void NRF24Rpc::receive()
+{
+	// A node that sent us a packet of its own still has to see the ACK and settle in RX mode before it can take
+	// one of ours, sending before that costs a retry (see startSend())
+	static const uint16_t turnaround = 300;
+
+	uint8_t packet[32];
+	uint8_t pipe;
+	uint8_t length;
+
+	while ((length = radio.receive(packet, sizeof(packet), &pipe)))
+	{
+		if (length < NRF24_RPC_HEADER_SIZE) continue;
+
+		uint8_t kind = packet[0] & ~NRF24_RPC_MORE;
+
+		bool ownPacket = false;
+		if (kind == NRF24_RPC_REQUEST) ownPacket = handleRequest(packet, length, pipe);
+		else if (kind == NRF24_RPC_REPLY) ownPacket = handleReply(packet, length);
+
+		if (ownPacket) peerListening = radio.getRXTimestamp() + turnaround;
+
+		// polls are only sent for their ACK
+	}
+}
+
+/*********************************************************/
+
+bool NRF24Rpc::handleRequest(uint8_t *packet, uint8_t length, uint8_t pipe)
+{
+	uint8_t id = packet[1];
+	uint8_t method = packet[2];
+	uint8_t from = packet[3];
+	bool more = packet[0] & NRF24_RPC_MORE;
+
+	// the same request again, the method already ran
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		nrf24_rpc_slot_t &slot = slots[i];
+		if (slot.state != replyQueued && slot.state != replyForAck && slot.state != replySent) continue;
+		if (slot.address != from || slot.id != id) continue;
+
+		// the reply didn't make it, it goes out again
+		if (slot.state == replySent)
+		{
+			slot.pipe = pipe;
+			slot.state = more ? replyForAck : replyQueued;
+			queueAckReplies();
+		}
+
+		return !more;
+	}
+
+	// the reply is put together in a slot, it's kept for a while after it went out (see duplicateWindow)
+	int8_t free = freeSlot();
+	if (free < 0) return false;		// no room, the call times out on the client
+
+	nrf24_rpc_slot_t &slot = slots[free];
+	slot.address = from;
+	slot.id = id;
+	slot.pipe = pipe;
+	slot.length = 0;
+
+	// in case the client is gone and never picks it up
+	static const uint16_t replyLifetime = 250;
+	slot.deadline = millis() + replyLifetime;
+
+	if (method < numMethods && methods[method])
+	{
+		slot.method = NRF24_RPC_OK;
+		slot.length = methods[method](from, packet + NRF24_RPC_HEADER_SIZE, length - NRF24_RPC_HEADER_SIZE, slot.data);
+		if (slot.length > NRF24_RPC_DATA_SIZE) slot.length = NRF24_RPC_DATA_SIZE;
+	}
+	else
+	{
+		slot.method = NRF24_RPC_NO_METHOD;
+	}
+
+	// When the client is about to send again the reply goes back with the ACK without costing any airtime.
+	// It has to, sending it now would only collide with the client's next packet. queueAckReplies() keeps trying
+	// Otherwise it's sent by startSend()
+	slot.state = more ? replyForAck : replyQueued;
+	queueAckReplies();
+
+	return !more;
+}
+
+/*********************************************************/
+
+bool NRF24Rpc::handleReply(uint8_t *packet, uint8_t length)
+{
+	// someone else's, it came with the ACK of our packet instead of theirs
+	if (packet[3] != radio.ownAddress) return false;
+
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		// the reply can come in before we've seen the request was delivered
+		if (slots[i].state != callQueued && slots[i].state != callSent) continue;
+		if (slots[i].id != packet[1]) continue;
+
+		// without NRF24_RPC_MORE the server sent it as a packet of its own
+		bool ownPacket = !slots[i].more;
+
+		finish(i, (nrf24_rpc_status_e)packet[2], packet + NRF24_RPC_HEADER_SIZE, length - NRF24_RPC_HEADER_SIZE);
+		return ownPacket;
+	}
+
+	return false;
+}
+
+/*********************************************************/
+
+void NRF24Rpc::queueAckReplies()
+{
+	uint8_t packet[NRF24_RPC_HEADER_SIZE + NRF24_RPC_DATA_SIZE];
+
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		nrf24_rpc_slot_t &slot = slots[i];
+		if (slot.state != replyForAck) continue;
+
+		// the rest has to wait until responses went out. Once queued the response buffer takes care of it
+		if (!radio.queueResponse(packet, buildReply(packet, slot), slot.pipe)) return;
+
+		slot.state = replySent;
+		slot.deadline = millis() + duplicateWindow;
+	}
+}
+
+/*********************************************************/
+
+uint8_t NRF24Rpc::buildReply(uint8_t *packet, nrf24_rpc_slot_t &slot)
+{
+	packet[0] = NRF24_RPC_REPLY;
+	packet[1] = slot.id;
+	packet[2] = slot.method;
+	packet[3] = slot.address;
+	memcpy(packet + NRF24_RPC_HEADER_SIZE, slot.data, slot.length);
+
+	return NRF24_RPC_HEADER_SIZE + slot.length;
+}
+
+/*********************************************************/
+
+void NRF24Rpc::checkDeadlines()
+{
+	uint32_t now = millis();
+
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		nrf24_rpc_slot_t &slot = slots[i];
+
+		if ((int32_t)(now - slot.deadline) < 0) continue;
+
+		if (slot.state == replyForAck || slot.state == replySent)
+		{
+			slot.state = slotFree;
+			continue;
+		}
+
+		if (slot.state != callQueued && slot.state != callSent) continue;
+
+		// the outcome of the transmission decides which it is
+		if (sending == i) continue;
+
+		finish(i, slot.state == callSent ? NRF24_RPC_TIMEOUT : NRF24_RPC_SEND_FAILED, NULL, 0);
+	}
+}
+
+/*********************************************************/
+
+bool NRF24Rpc::finishSend()
+{
+	if (sending == notSending) return true;
+
+	if (!radio.pollSend()) return false;
+
+	bool delivered = radio.sendResult() == NRF24_SEND_OK;
+
+	if (sending >= 0)
+	{
+		nrf24_rpc_slot_t &slot = slots[sending];
+
+		if (slot.state == replyQueued)
+		{
+			// The client gets one go, it times out if that didn't work. Unless it sends the request again
+			slot.state = replySent;
+			slot.deadline = millis() + duplicateWindow;
+		}
+		else if (slot.state == callQueued && delivered)
+		{
+			slot.state = callSent;
+
+			// the server sends the reply right away, see startSend()
+			if (!slot.more)
+			{
+				awaiting = sending;
+				awaitingSince = millis();
+			}
+		}
+
+		// a failed request stays queued and is tried again until the deadline
+	}
+
+	sending = notSending;
+	return true;
+}
+
+/*********************************************************/
+
+void NRF24Rpc::startSend()
+{
+	// Transmitting takes us out of RX mode, a reply sent meanwhile isn't ACKed and is tried again in lockstep
+	// with our own retries. Give it some time to come in first
+	if (awaiting >= 0)
+	{
+		static const uint8_t awaitTime = 10;
+		bool waiting = slots[awaiting].state == callSent && !slots[awaiting].more;
+		if (waiting && millis() - awaitingSince < awaitTime) return;
+
+		awaiting = -1;
+	}
+
+	if ((int32_t)(micros() - peerListening) < 0) return;
+
+	uint8_t packet[NRF24_RPC_HEADER_SIZE + NRF24_RPC_DATA_SIZE];
+
+	int8_t next = nextToSend();
+	if (next >= 0)
+	{
+		nrf24_rpc_slot_t &slot = slots[next];
+		uint8_t length;
+
+		if (slot.state == replyQueued)
+		{
+			length = buildReply(packet, slot);
+		}
+		else
+		{
+			// tell the server to keep the reply for the ACK of the next one
+			slot.more = moreFor(slot.address, next);
+
+			packet[0] = NRF24_RPC_REQUEST | (slot.more ? NRF24_RPC_MORE : 0);
+			packet[1] = slot.id;
+			packet[2] = slot.method;
+			packet[3] = radio.ownAddress;
+			memcpy(packet + NRF24_RPC_HEADER_SIZE, slot.data, slot.length);
+			length = NRF24_RPC_HEADER_SIZE + slot.length;
+		}
+
+		// the radio could refuse, e.g. when the server is out of credits (see NRF24::setFlowControl())
+		if (radio.beginSend(slot.address, packet, length))
+		{
+			sending = next;
+			lastSent = millis();
+		}
+		return;
+	}
+
+	uint8_t server;
+	if (pollTarget(&server))
+	{
+		packet[0] = NRF24_RPC_POLL;
+		packet[1] = 0;
+		packet[2] = 0;
+		packet[3] = radio.ownAddress;
+
+		if (radio.beginSend(server, packet, NRF24_RPC_HEADER_SIZE))
+		{
+			sending = sendingPoll;
+			lastSent = millis();
+		}
+	}
+}
+
+/*********************************************************/
+
+int8_t NRF24Rpc::nextToSend()
+{
+	// replies first, a client is waiting for them
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		if (slots[i].state == replyQueued) return i;
+	}
+
+	// then the oldest call, IDs go up with every call
+	int8_t oldest = -1;
+	uint8_t oldestAge = 0;
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		if (slots[i].state != callQueued) continue;
+
+		uint8_t age = nextId - slots[i].id;
+		if (oldest < 0 || age > oldestAge)
+		{
+			oldest = i;
+			oldestAge = age;
+		}
+	}
+
+	return oldest;
+}
+
+/*********************************************************/
+
+bool NRF24Rpc::moreFor(uint8_t server, int8_t except)
+{
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		if (i != except && slots[i].state == callQueued && slots[i].address == server) return true;
+	}
+	return false;
+}
+
+/*********************************************************/
+
+bool NRF24Rpc::pollTarget(uint8_t *server)
+{
+	// give the server time to run the method before asking again
+	static const uint8_t pollInterval = 2;
+	if (millis() - lastSent < pollInterval) return false;
+
+	// a server we promised another packet to and have nothing more to send to
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		if (slots[i].state != callSent || !slots[i].more) continue;
+		if (moreFor(slots[i].address, -1)) continue;
+
+		*server = slots[i].address;
+		return true;
+	}
+
+	return false;
+}
+
+/*********************************************************/
+
+void NRF24Rpc::finish(int8_t call, nrf24_rpc_status_e status, uint8_t *data, uint8_t length)
+{
+	// free before the handler runs so it can make the next call right away
+	slots[call].state = slotFree;
+
+	if (replyHandler) replyHandler(call, status, data, length);
+}
+
+/*********************************************************/
+
+int8_t NRF24Rpc::freeSlot()
+{
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		if (slots[i].state == slotFree) return i;
+	}
+
+	// the reply that went out first is the least likely to be asked for again
+	int8_t oldest = -1;
+	for (uint8_t i = 0; i < numSlots; i++)
+	{
+		if (slots[i].state != replySent) continue;
+		if (oldest < 0 || (int32_t)(slots[i].deadline - slots[oldest].deadline) < 0) oldest = i;
+	}
+
+	return oldest;
+}
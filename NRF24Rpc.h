@@ -0,0 +1,118 @@
+#ifndef NRF24RPC_H_
+#define NRF24RPC_H_
+
+#include "NRF24.h"
+
+// Every packet starts with a 4 byte header, the remaining 28 bytes are data
+//   requests: kind (NRF24_RPC_REQUEST, NRF24_RPC_MORE set when more packets follow), call ID, method, client address
+//   replies:  kind (NRF24_RPC_REPLY), call ID, status, client address
+//   polls:    kind (NRF24_RPC_POLL), 0, 0, client address. No data, they're only sent to pick up replies
+#define NRF24_RPC_HEADER_SIZE	4
+#define NRF24_RPC_DATA_SIZE		28
+
+#define NRF24_RPC_REQUEST		0xE0
+#define NRF24_RPC_MORE			0x01
+#define NRF24_RPC_REPLY			0xD0
+#define NRF24_RPC_POLL			0xC0
+
+typedef enum
+{
+	NRF24_RPC_OK = 0,
+	NRF24_RPC_NO_METHOD,		// the server doesn't have it
+	NRF24_RPC_TIMEOUT,			// the request got there but the reply didn't make it before the deadline
+	NRF24_RPC_SEND_FAILED		// the request didn't get there before the deadline
+} nrf24_rpc_status_e;
+
+// Runs a request on the server. Puts up to NRF24_RPC_DATA_SIZE bytes in reply and returns how many
+typedef uint8_t (*nrf24_rpc_method_t)(uint8_t from, uint8_t *data, uint8_t length, uint8_t *reply);
+
+// Called on the client once a call is done, call is what call() returned. data is only valid during the call
+typedef void (*nrf24_rpc_reply_handler_t)(int8_t call, nrf24_rpc_status_e status, uint8_t *data, uint8_t length);
+
+// calls in progress and replies waiting to go out, see NRF24Rpc()
+typedef struct
+{
+	uint8_t state;		// used by NRF24Rpc
+	uint8_t address;	// server of a call, client of a reply
+	uint8_t id;
+	uint8_t method;		// status for a reply
+	bool more;			// a request sent with NRF24_RPC_MORE, its reply comes with an ACK
+	uint8_t pipe;		// the pipe a request came in on, for a reply that goes with an ACK
+	uint8_t length;
+	uint8_t data[NRF24_RPC_DATA_SIZE];
+	uint32_t deadline;
+} nrf24_rpc_slot_t;
+
+// Remote procedure calls between nodes. A client can have as many calls going as it has slots, to one server or
+// several, each with its own deadline. They're sent back to back without waiting for the replies
+// A server has a table of methods, the method number in a request is the index. The reply goes back with the
+// ACK of the client's next packet when the client said there is one (it sends a poll if it runs out of requests),
+// otherwise as a packet of its own. The client doesn't transmit while that's on its way, it wouldn't hear it
+// The reply rides on an ACK to whoever sends to the server's address next. With more than one client per address a
+// reply can end up with the wrong one, which drops it, and the call times out. Clients that make a lot of calls
+// are best given an address of their own on the server (listenToAddress())
+// A request that comes in again because the client missed the ACK gets the same reply without running the
+// method again
+// Nodes have to be listening to get replies (and requests). All packets to the node are expected to be RPC packets,
+// sequence tagging isn't supported
+class NRF24Rpc
+{
+	public:
+		// slots hold calls until they're done and replies until they're sent, a server that gets requests from
+		// many clients at once needs a few too
+		NRF24Rpc(NRF24 &radio, nrf24_rpc_slot_t *slots, uint8_t numSlots);
+
+		// server. Replies wait for the client's next packet in the radio's response buffer, returns false without
+		// one (see NRF24::setResponseBuffer())
+		bool setMethods(nrf24_rpc_method_t *methods, uint8_t numMethods);
+
+		// client. returns the call, which the handler gets once it's done, or -1 if all slots are in use
+		// timeout is in mS
+		void onReply(nrf24_rpc_reply_handler_t handler);
+		int8_t call(uint8_t server, uint8_t method, const uint8_t *data, uint8_t length, uint16_t timeout = 100);
+		uint8_t pending();		// calls that aren't done yet
+
+		// Does all the work, call from loop(). Handles what came in, sends what's waiting and ends calls that
+		// ran out of time
+		void poll();
+
+	private:
+		void receive();
+		bool handleRequest(uint8_t *packet, uint8_t length, uint8_t pipe);
+		bool handleReply(uint8_t *packet, uint8_t length);
+		void queueAckReplies();
+		uint8_t buildReply(uint8_t *packet, nrf24_rpc_slot_t &slot);
+		void checkDeadlines();
+		bool finishSend();
+		void startSend();
+		int8_t nextToSend();
+		bool moreFor(uint8_t server, int8_t except);
+		bool pollTarget(uint8_t *server);
+		void finish(int8_t call, nrf24_rpc_status_e status, uint8_t *data, uint8_t length);
+		int8_t freeSlot();
+
+		NRF24 &radio;
+
+		nrf24_rpc_slot_t *slots;
+		uint8_t numSlots;
+
+		nrf24_rpc_method_t *methods;
+		uint8_t numMethods;
+
+		nrf24_rpc_reply_handler_t replyHandler;
+
+		uint8_t nextId;
+
+		// what beginSend() is busy with, the slot or sendingPoll
+		int8_t sending;
+		uint32_t lastSent;
+
+		// call whose reply comes as a packet of its own, we keep quiet while it's on its way. -1 if none
+		int8_t awaiting;
+		uint32_t awaitingSince;
+
+		// micros() when the node that just sent us a packet of its own is back in RX mode
+		uint32_t peerListening;
+};
+
+#endif // NRF24RPC_H_
@@ -0,0 +1,222 @@
+#include "NRF24Stream.h"
+
+/*********************************************************
+ *
+ * PUBLIC
+ *
+ *********************************************************/
+
+NRF24Stream::NRF24Stream(NRF24 &_radio, uint8_t _window)
+	: radio(_radio)
+{
+	// sequence numbers are 7 bits, the window must be less than half of that to tell old frames from new ones
+	if (_window == 0) _window = 1;
+	if (_window > 63) _window = 63;
+	window = _window;
+
+	synced = false;
+	txSeq = 0;
+
+	ackQueued = false;
+	rxSeq = 0;
+
+	frameHead = 0;
+	frameCount = 0;
+}
+
+/*********************************************************/
+
+uint16_t NRF24Stream::write(uint8_t targetAddress, uint8_t *data, uint16_t length)
+{
+	if (length == 0) return 0;
+
+	// we don't know what the receiver expects yet, ask before sending anything
+	if (!synced)
+	{
+		if (poll(targetAddress, &txSeq) < 1) return 0;
+		synced = true;
+	}
+
+	uint16_t numFrames = (length + NRF24_STREAM_FRAME_SIZE - 1) / NRF24_STREAM_FRAME_SIZE;
+	uint16_t base = 0;		// oldest frame not acknowledged
+	uint16_t next = 0;		// next frame to send
+	uint8_t firstSeq = txSeq;
+	uint8_t failedPolls = 0;
+
+	while (base < numFrames)
+	{
+		uint16_t end = base + window;
+		if (end > numFrames) end = numFrames;
+
+		sendFrames(targetAddress, data, length, next, end, firstSeq);
+		next = end;
+
+		// The first answer can be from before the receiver got to the frames. Once a poll has been received,
+		// the answer to the next one covers everything sent before it
+		bool heard = false;
+
+		while (base < next)
+		{
+			uint8_t ackSeq;
+			int8_t answer = poll(targetAddress, &ackSeq);
+
+			if (answer > 0)
+			{
+				uint8_t acked = (ackSeq - (firstSeq + base)) & NRF24_STREAM_SEQ;
+
+				if (acked > next - base)
+				{
+					// receiver expects something we never sent, it was probably restarted. Carry on from where it is
+					firstSeq = (ackSeq - base) & NRF24_STREAM_SEQ;
+					acked = 0;
+				}
+
+				if (acked)
+				{
+					base += acked;
+					failedPolls = 0;
+					if (base == next) break;
+				}
+			}
+
+			// anything not acknowledged by now was lost. Without an answer the receiver hasn't got to the last poll yet
+			if (answer > 0 && heard) break;
+			if (answer >= 0) heard = true;
+
+			if (++failedPolls >= NRF24_STREAM_MAX_POLLS)
+			{
+				synced = false;
+				break;
+			}
+		}
+
+		if (!synced) break;
+
+		next = base;
+	}
+
+	txSeq = (firstSeq + base) & NRF24_STREAM_SEQ;
+
+	if (base == numFrames) return length;
+	return base * NRF24_STREAM_FRAME_SIZE;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Stream::read(uint8_t *buf, uint8_t bufferSize)
+{
+	// the sender can't make progress until there's something in the ACK payload
+	if (!ackQueued) queueAck();
+
+	if (!frameCount) drain();
+	if (!frameCount) return 0;
+
+	uint8_t length = frameLengths[frameHead];
+	memcpy(buf, frames[frameHead], bufferSize < length ? bufferSize : length);
+
+	frameHead = (frameHead + 1) % NRF24_STREAM_RX_FRAMES;
+	--frameCount;
+
+	return length;
+}
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+void NRF24Stream::sendFrames(uint8_t targetAddress, uint8_t *data, uint16_t length, uint16_t from, uint16_t to, uint8_t firstSeq)
+{
+	// up to a full FIFO worth of frames at a time
+	uint8_t frames[3 * 32];
+
+	bool ack = radio.getACKEnabled();
+	radio.setACKEnabled(false);
+
+	while (from < to)
+	{
+		uint8_t count = 0;
+		uint8_t frameSize = 0;
+
+		while (from < to && count < 3)
+		{
+			uint16_t offset = from * NRF24_STREAM_FRAME_SIZE;
+			uint8_t size = length - offset > NRF24_STREAM_FRAME_SIZE ? NRF24_STREAM_FRAME_SIZE : length - offset;
+
+			// a burst needs equally sized packets, only the very last frame can be shorter
+			if (count && size + 1 != frameSize) break;
+			frameSize = size + 1;
+
+			uint8_t *frame = frames + count * frameSize;
+			frame[0] = (firstSeq + from) & NRF24_STREAM_SEQ;
+			memcpy(frame + 1, data + offset, size);
+
+			++count;
+			++from;
+		}
+
+		radio.sendBurst(targetAddress, frames, frameSize, count);
+	}
+
+	radio.setACKEnabled(ack);
+}
+
+/*********************************************************/
+
+int8_t NRF24Stream::poll(uint8_t targetAddress, uint8_t *ackSeq)
+{
+	uint8_t header = NRF24_STREAM_POLL;
+	uint8_t response[32];
+
+	int8_t received = radio.send(targetAddress, &header, 1, response, sizeof(response));
+	if (received < 1) return received;
+
+	*ackSeq = response[0] & NRF24_STREAM_SEQ;
+
+	return 1;
+}
+
+/*********************************************************/
+
+void NRF24Stream::drain()
+{
+	uint8_t frame[32];
+	uint8_t length;
+	bool progress = false;
+
+	while (frameCount < NRF24_STREAM_RX_FRAMES && (length = radio.receive(frame, sizeof(frame))))
+	{
+		if (length > sizeof(frame)) continue;
+
+		if (frame[0] & NRF24_STREAM_POLL)
+		{
+			// the poll took our ACK payload with it
+			ackQueued = false;
+			continue;
+		}
+
+		// out of order, either a frame was lost or this one is sent again
+		if ((frame[0] & NRF24_STREAM_SEQ) != rxSeq) continue;
+
+		rxSeq = (rxSeq + 1) & NRF24_STREAM_SEQ;
+		progress = true;
+
+		uint8_t slot = (frameHead + frameCount) % NRF24_STREAM_RX_FRAMES;
+		frameLengths[slot] = length - 1;
+		memcpy(frames[slot], frame + 1, length - 1);
+		++frameCount;
+	}
+
+	// once for everything that came in
+	if (progress || !ackQueued) queueAck();
+}
+
+/*********************************************************/
+
+void NRF24Stream::queueAck()
+{
+	// only the latest progress is interesting, replace what's still waiting in the chip
+	if (ackQueued) radio.clearResponses();
+	ackQueued = radio.queueResponse(&rxSeq, 1);
+}
@@ -0,0 +1,65 @@
+#ifndef NRF24STREAM_H_
+#define NRF24STREAM_H_
+
+#include "NRF24.h"
+
+// Every frame starts with a header byte:
+//   bit 7:    poll frame. Sent with ACK to fetch the receiver's progress from the ACK payload, carries no data
+//   bits 6-0: sequence number of a data frame
+// The receiver keeps the next sequence number it expects queued as its ACK payload
+#define NRF24_STREAM_POLL		0x80
+#define NRF24_STREAM_SEQ		0x7F
+#define NRF24_STREAM_FRAME_SIZE	31
+
+// Give up after this many polls in a row without progress
+#define NRF24_STREAM_MAX_POLLS	16
+
+// frames the receiver takes from the chip at a time, as many as its RX FIFO holds
+#define NRF24_STREAM_RX_FRAMES	3
+
+// Windowed bulk transfer. Data frames are sent without ACK so they go out back to back, after a window
+// of frames a poll is sent and the receiver answers with how far it got. Lost frames are sent again (go-back-N)
+// The receiver takes all frames waiting in the chip at once and updates its progress once for all of them.
+// The progress only reaches the sender with the ACK of the next poll, so every window costs at least one pass
+// through the receiver's loop. It beats calling send() for every packet when read() is called every few hundred uS,
+// with a slower receiver send() is faster (extras/host/sim_stream.cpp compares both). A window larger than the
+// chip's RX FIFO (3) only pays off when the receiver calls read() about as fast as frames come in
+// The receiver has to use setAddress() and startListening(), data is sent to its own address
+class NRF24Stream
+{
+	public:
+		// window is the number of frames sent before waiting for the receiver's progress (max 63)
+		NRF24Stream(NRF24 &radio, uint8_t window = 3);
+
+		// Sender: transfer data to the target, blocks until everything is acknowledged or the receiver stops responding
+		// returns the number of bytes delivered
+		uint16_t write(uint8_t targetAddress, uint8_t *data, uint16_t length);
+
+		// Receiver: returns the data of the next frame in order, 0 if there's none
+		uint8_t read(uint8_t *buf, uint8_t bufferSize);
+
+	private:
+		void sendFrames(uint8_t targetAddress, uint8_t *data, uint16_t length, uint16_t from, uint16_t to, uint8_t firstSeq);
+		// 1 with the receiver's progress, 0 if it had none queued, -1 if the poll wasn't received
+		int8_t poll(uint8_t targetAddress, uint8_t *ackSeq);
+		void drain();
+		void queueAck();
+
+		NRF24 &radio;
+		uint8_t window;
+
+		bool synced;
+		uint8_t txSeq;
+
+		// ackQueued is set while our progress waits in the chip for the next poll
+		bool ackQueued;
+		uint8_t rxSeq;
+
+		// in order frames taken from the chip that read() hasn't returned yet
+		uint8_t frames[NRF24_STREAM_RX_FRAMES][NRF24_STREAM_FRAME_SIZE];
+		uint8_t frameLengths[NRF24_STREAM_RX_FRAMES];
+		uint8_t frameHead;
+		uint8_t frameCount;
+};
+
+#endif // NRF24STREAM_H_
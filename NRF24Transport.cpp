@@ -0,0 +1,162 @@
+#include "NRF24Transport.h"
+#include "NRF24Reg.h"
+
+/*********************************************************
+ *
+ * NRF24Transport
+ *
+ *********************************************************/
+
+void NRF24Transport::transfer(const uint8_t *out, uint8_t *in, uint8_t length)
+{
+	while (length--)
+	{
+		uint8_t received = transfer(out ? *out++ : NOP);
+		if (in) *in++ = received;
+	}
+}
+
+/*********************************************************
+ *
+ * NRF24ArduinoSPI
+ *
+ *********************************************************/
+
+NRF24ArduinoSPI::NRF24ArduinoSPI(uint32_t clock)
+#ifdef SPI_HAS_TRANSACTION
+	: settings(clock, MSBFIRST, SPI_MODE0)
+#endif
+{
+}
+
+/*********************************************************/
+
+void NRF24ArduinoSPI::begin()
+{
+	SPI.begin();
+
+#ifndef SPI_HAS_TRANSACTION
+	// no way to set the clock per transaction, /4 gives 4MHz on a 16MHz board
+	SPI.setClockDivider(SPI_CLOCK_DIV4);
+#endif
+}
+
+/*********************************************************/
+
+void NRF24ArduinoSPI::beginTransaction()
+{
+#ifdef SPI_HAS_TRANSACTION
+	SPI.beginTransaction(settings);
+#endif
+}
+
+/*********************************************************/
+
+void NRF24ArduinoSPI::endTransaction()
+{
+#ifdef SPI_HAS_TRANSACTION
+	SPI.endTransaction();
+#endif
+}
+
+/*********************************************************/
+
+uint8_t NRF24ArduinoSPI::transfer(uint8_t data)
+{
+	return SPI.transfer(data);
+}
+
+/*********************************************************/
+
+void NRF24ArduinoSPI::transfer(const uint8_t *out, uint8_t *in, uint8_t length)
+{
+	if (!in)
+	{
+		// nothing to store, SPI.transfer(buf, length) would overwrite the data we're sending
+		while (length--)
+		{
+			SPI.transfer(out ? *out++ : NOP);
+		}
+		return;
+	}
+
+	// the buffer version transfers in place
+	if (out)
+	{
+		memcpy(in, out, length);
+	}
+	else
+	{
+		memset(in, NOP, length);
+	}
+
+	SPI.transfer(in, length);
+}
+
+/*********************************************************/
+
+void NRF24ArduinoSPI::usingInterrupt(uint8_t interrupt)
+{
+#ifdef SPI_HAS_TRANSACTION
+	SPI.usingInterrupt(interrupt);
+#endif
+}
+
+#if defined(SPDR)
+
+/*********************************************************
+ *
+ * NRF24AvrSPI
+ *
+ *********************************************************/
+
+NRF24AvrSPI::NRF24AvrSPI(uint8_t _clockDivider)
+{
+	clockDivider = _clockDivider;
+}
+
+/*********************************************************/
+
+void NRF24AvrSPI::begin()
+{
+	// let the SPI library take care of the pins and mode, we only use the registers afterwards
+	SPI.begin();
+	SPI.setDataMode(SPI_MODE0);
+	SPI.setBitOrder(MSBFIRST);
+	SPI.setClockDivider(clockDivider);
+}
+
+/*********************************************************/
+
+uint8_t NRF24AvrSPI::transfer(uint8_t data)
+{
+	SPDR = data;
+	while (!(SPSR & _BV(SPIF)));
+	return SPDR;
+}
+
+/*********************************************************/
+
+void NRF24AvrSPI::transfer(const uint8_t *out, uint8_t *in, uint8_t length)
+{
+	if (length == 0) return;
+
+	SPDR = out ? *out++ : NOP;
+
+	while (--length)
+	{
+		// fetch the next byte while the current one is being clocked out
+		uint8_t next = out ? *out++ : NOP;
+
+		while (!(SPSR & _BV(SPIF)));
+		uint8_t received = SPDR;
+		SPDR = next;
+
+		if (in) *in++ = received;
+	}
+
+	while (!(SPSR & _BV(SPIF)));
+	if (in) *in = SPDR;
+}
+
+#endif
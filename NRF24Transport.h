@@ -0,0 +1,74 @@
+#ifndef NRF24TRANSPORT_H_
+#define NRF24TRANSPORT_H_
+
+#include <Arduino.h>
+#include <SPI.h>
+
+// How NRF24 talks SPI. NRF24 drives CSN itself, a transport only moves the bytes.
+// Every command is wrapped in beginTransaction()/endTransaction(), called before CSN goes low and after it goes high
+class NRF24Transport
+{
+	public:
+		virtual void begin() = 0;
+
+		virtual void beginTransaction() {}
+		virtual void endTransaction() {}
+
+		virtual uint8_t transfer(uint8_t data) = 0;
+
+		// Clock out length bytes from out and store what comes back in in
+		// out can be NULL to clock out NOPs, in can be NULL if the result isn't needed
+		virtual void transfer(const uint8_t *out, uint8_t *in, uint8_t length);
+
+		// Called by begin() with the interrupt of the IRQ pin, its handler talks to the chip (see setRXBuffer()).
+		// Transports sharing the bus should keep it from firing in the middle of another device's transfer
+		virtual void usingInterrupt(uint8_t interrupt) {}
+};
+
+// Arduino SPI library. Uses SPI transactions where available so it plays nice with other devices on the bus
+class NRF24ArduinoSPI : public NRF24Transport
+{
+	public:
+		// maximum clock frequency for NRF24L01+ is 10MHz
+		// when using a prototype board with long wires it may be better to go slower for better signal integrity
+		// sometimes data can be corrupted so try putting a slower clock if the results are unpredicatable/weird/etc
+		NRF24ArduinoSPI(uint32_t clock = 4000000);
+
+		virtual void begin();
+
+		virtual void beginTransaction();
+		virtual void endTransaction();
+
+		virtual uint8_t transfer(uint8_t data);
+		virtual void transfer(const uint8_t *out, uint8_t *in, uint8_t length);
+
+		// SPI.usingInterrupt(), the SPI library masks it during every transaction on the bus
+		virtual void usingInterrupt(uint8_t interrupt);
+
+	private:
+#ifdef SPI_HAS_TRANSACTION
+		SPISettings settings;
+#endif
+};
+
+#if defined(SPDR)
+// Direct access to the AVR SPI registers. Loads the next byte while the previous one is still being clocked out
+// so buffer transfers run back to back. Doesn't use SPI transactions, so don't share the bus with devices using other settings
+// Nor with an RX buffer filled from the interrupt (see setRXBuffer()) when other devices are on the bus: nothing keeps
+// the interrupt from talking to the radio in the middle of their transfers
+class NRF24AvrSPI : public NRF24Transport
+{
+	public:
+		NRF24AvrSPI(uint8_t clockDivider = SPI_CLOCK_DIV4);
+
+		virtual void begin();
+
+		virtual uint8_t transfer(uint8_t data);
+		virtual void transfer(const uint8_t *out, uint8_t *in, uint8_t length);
+
+	private:
+		uint8_t clockDivider;
+};
+#endif
+
+#endif // NRF24TRANSPORT_H_
@@ -0,0 +1,75 @@
+#include <SPI.h>
+#include <NRF24.h>
+
+NRF24 radio;
+
+bool tx;
+
+uint32_t loopsWhileSending = 0;
+unsigned long previousTransmission = 0;
+
+void setup()
+{
+	Serial.begin(115200);
+	Serial.println(F("NRF24 Async send example"));
+
+	radio.begin(9, 10);
+
+	// Pin 7 sets the mode (Sender or Receiver). Connect to GND on the sender
+	pinMode(7, INPUT_PULLUP);
+	tx = !digitalRead(7);
+
+	if (tx)
+	{
+		// transmitter doesn't need an address
+		radio.setActive(true);
+	}
+	else
+	{
+		// set our address
+		radio.setAddress(0xD2);
+		radio.startListening();
+	}
+
+	Serial.print(F("TX mode: "));
+	Serial.println(tx);
+}
+
+void loop()
+{
+	if (tx)
+	{
+		if (radio.sendResult() == NRF24_SEND_PENDING)
+		{
+			if (!radio.pollSend())
+			{
+				// free to do other work while the packet is in flight
+				++loopsWhileSending;
+				return;
+			}
+
+			// done, report it
+			Serial.print(radio.sendResult() == NRF24_SEND_OK ? F("OK") : F("failed"));
+			Serial.print(F(", loop ran "));
+			Serial.print(loopsWhileSending);
+			Serial.println(F(" times while sending"));
+		}
+
+		if (millis() - previousTransmission >= 1000)
+		{
+			uint16_t v = analogRead(0);
+			uint8_t buf[2] = { (uint8_t)(v >> 8), (uint8_t)(v & 0xFF) };
+			radio.beginSend(0xD2, buf, sizeof(buf));
+
+			loopsWhileSending = 0;
+			previousTransmission = millis();
+		}
+	}
+	else if (radio.available())
+	{
+		uint8_t buf[2];
+		radio.read(buf, sizeof(buf));
+		Serial.print(F("Received sample "));
+		Serial.println(((uint16_t)buf[0] << 8) | buf[1]);
+	}
+}
@@ -0,0 +1,66 @@
+#include <SPI.h>
+#include <NRF24.h>
+#include <NRF24Messenger.h>
+
+NRF24 radio;
+
+// Two messages of up to 256 bytes can be reassembled at the same time
+uint8_t reassemblyBuffer[512];
+NRF24Messenger messenger(radio, reassemblyBuffer, sizeof(reassemblyBuffer), 2);
+
+bool tx;
+
+void setup()
+{
+	Serial.begin(115200);
+	Serial.println(F("NRF24 Messages example"));
+
+	radio.begin(9, 10);
+
+	// Pin 7 sets the mode (Sender or Receiver). Connect to GND on the sender
+	pinMode(7, INPUT_PULLUP);
+	tx = !digitalRead(7);
+
+	if (tx)
+	{
+		// sending lots of fragments, stay powered up between them
+		radio.setActive(true);
+	}
+	else
+	{
+		radio.setAddress(0xD2);
+		radio.startListening();
+	}
+
+	Serial.print(F("TX mode: "));
+	Serial.println(tx);
+}
+
+void loop()
+{
+	if (tx)
+	{
+		// 200 bytes, more than 6 regular packets
+		uint8_t message[200];
+		for (uint8_t i = 0; i < sizeof(message); i++)
+		{
+			message[i] = i;
+		}
+
+		Serial.print(F("Sending message.. "));
+		bool sent = messenger.sendMessage(0xD2, message, sizeof(message));
+		Serial.println(sent ? F("OK") : F("failed"));
+		delay(1000);
+	}
+	else
+	{
+		uint8_t message[256];
+		uint16_t length = messenger.readMessage(message, sizeof(message));
+		if (length)
+		{
+			Serial.print(F("Received "));
+			Serial.print(length);
+			Serial.println(F(" byte message"));
+		}
+	}
+}
@@ -0,0 +1,245 @@
+#include <SPI.h>
+#include <NRF24.h>
+
+// Round trip times of the three ways to get an answer from another node: a send() that comes back with the ACK,
+// a send() that comes back with an ACK payload and an echo sent back by the other node's application
+// Goes through every payload size at every data rate and a few retry delays, and prints min, median,
+// 99th percentile and max in uS for each. extras/host/sim_rtt.cpp runs the same on simulated radios
+
+NRF24 radio;
+
+bool tx;
+
+#define INITIATOR 0xD1
+#define RESPONDER 0xD2
+
+#define SAMPLES 100
+#define ECHO_TIMEOUT 20000	// uS
+
+// tells the responder how to answer and at which data rate
+#define CONFIG_SIZE 4
+#define CONFIG_MARKER0 0xC0
+#define CONFIG_MARKER1 0xF1
+
+enum
+{
+	MODE_ACK = 0,
+	MODE_ACK_PAYLOAD,
+	MODE_ECHO,
+	NUM_MODES
+};
+
+typedef struct
+{
+	uint16_t min;
+	uint16_t median;
+	uint16_t p99;
+	uint16_t max;
+	uint8_t failed;
+} stats_t;
+
+const nrf24_datarate_e dataRates[] = { NRF24_250KBPS, NRF24_1MBPS, NRF24_2MBPS };
+const char *dataRateNames[] = { "250kbps", "1Mbps", "2Mbps" };
+
+// setRetries() delays, 250uS steps
+const uint8_t retryDelays[] = { 0, 3, 15 };
+
+uint8_t mode = MODE_ACK;
+uint16_t samples[SAMPLES];
+
+void setup()
+{
+	Serial.begin(115200);
+	Serial.println(F("NRF24 RTT example"));
+
+	radio.begin(9, 10);
+
+	// Pin 7 sets the mode (Initiator or Responder). Connect to GND on the initiator
+	pinMode(7, INPUT_PULLUP);
+	tx = !digitalRead(7);
+
+	// both stay powered up, otherwise every round trip includes the crystal starting up
+	radio.setPowerPolicy(NRF24_POWER_ALWAYS_ON);
+	radio.setAddress(tx ? INITIATOR : RESPONDER);
+	radio.startListening();
+
+	Serial.print(F("TX mode: "));
+	Serial.println(tx);
+}
+
+void loop()
+{
+	if (tx) runSweep();
+	else respond();
+}
+
+/*********************************************************/
+
+void respond()
+{
+	uint8_t buf[32];
+	uint8_t length = radio.receive(buf, sizeof(buf));
+	if (!length) return;
+
+	if (length == CONFIG_SIZE && buf[0] == CONFIG_MARKER0 && buf[1] == CONFIG_MARKER1)
+	{
+		// the initiator switches as soon as it has our ACK
+		radio.clearResponses();
+		radio.setDataRate((nrf24_datarate_e)buf[2]);
+		mode = buf[3];
+
+		// there's always one waiting for the next packet
+		if (mode == MODE_ACK_PAYLOAD) radio.queueResponse(buf, 1);
+		return;
+	}
+
+	if (mode == MODE_ACK_PAYLOAD) radio.queueResponse(buf, length);
+	else if (mode == MODE_ECHO) radio.send(INITIATOR, buf, length);
+}
+
+/*********************************************************/
+
+void runSweep()
+{
+	for (uint8_t r = 0; r < sizeof(retryDelays); r++)
+	{
+		radio.setRetries(retryDelays[r], 15);
+
+		for (uint8_t d = 0; d < sizeof(dataRates) / sizeof(dataRates[0]); d++)
+		{
+			Serial.println();
+			Serial.print(dataRateNames[d]);
+			Serial.print(F(", retry delay "));
+			Serial.print((retryDelays[r] + 1) * 250);
+			Serial.println(F("uS. min/median/p99/max uS and failures"));
+			Serial.println(F("size | ACK                      | ACK payload              | echo"));
+
+			for (uint8_t size = 1; size <= 32; size++)
+			{
+				stats_t stats[NUM_MODES];
+				for (uint8_t m = 0; m < NUM_MODES; m++)
+				{
+					configure(dataRates[d], m);
+					stats[m] = measure(m, size);
+				}
+
+				printRow(size, stats);
+			}
+		}
+	}
+
+	// back to where the responder starts after a reset, begin() sets 2 Mbps
+	configure(NRF24_2MBPS, MODE_ACK);
+	while (true);
+}
+
+/*********************************************************/
+
+void configure(nrf24_datarate_e dataRate, uint8_t m)
+{
+	uint8_t config[CONFIG_SIZE] = { CONFIG_MARKER0, CONFIG_MARKER1, (uint8_t)dataRate, m };
+
+	// sent at the rate we're at now, then we follow
+	while (!radio.send(RESPONDER, config, CONFIG_SIZE)) delay(10);
+	radio.setDataRate(dataRate);
+
+	// give it time to switch, and to get an ACK payload in place
+	delay(5);
+}
+
+/*********************************************************/
+
+stats_t measure(uint8_t m, uint8_t size)
+{
+	uint8_t data[32] = { 0 };
+	uint8_t response[32];
+	uint8_t count = 0;
+	uint8_t failed = 0;
+
+	for (uint8_t i = 0; i < SAMPLES; i++)
+	{
+		data[0] = i;
+		bool ok;
+
+		uint32_t started = micros();
+
+		if (m == MODE_ACK)
+		{
+			ok = radio.send(RESPONDER, data, size);
+		}
+		else if (m == MODE_ACK_PAYLOAD)
+		{
+			ok = radio.send(RESPONDER, data, size, response, sizeof(response)) > 0;
+		}
+		else
+		{
+			ok = radio.send(RESPONDER, data, size);
+			while (ok && !radio.receive(response, sizeof(response)))
+			{
+				if (micros() - started >= ECHO_TIMEOUT) ok = false;
+			}
+		}
+
+		uint32_t elapsed = micros() - started;
+
+		if (ok) samples[count++] = elapsed > 0xFFFF ? 0xFFFF : elapsed;
+		else ++failed;
+
+		// let the responder catch up
+		delay(2);
+	}
+
+	return summarize(count, failed);
+}
+
+/*********************************************************/
+
+stats_t summarize(uint8_t count, uint8_t failed)
+{
+	stats_t stats = { 0, 0, 0, 0, failed };
+	if (!count) return stats;
+
+	// insertion sort, there aren't many
+	for (uint8_t i = 1; i < count; i++)
+	{
+		uint16_t value = samples[i];
+		uint8_t j = i;
+		while (j > 0 && samples[j - 1] > value)
+		{
+			samples[j] = samples[j - 1];
+			--j;
+		}
+		samples[j] = value;
+	}
+
+	stats.min = samples[0];
+	stats.median = samples[count / 2];
+	stats.p99 = samples[(count - 1) * 99 / 100];
+	stats.max = samples[count - 1];
+
+	return stats;
+}
+
+/*********************************************************/
+
+void printColumn(uint16_t value, uint8_t width)
+{
+	char buf[8];
+	snprintf(buf, sizeof(buf), "%*u", width, value);
+	Serial.print(buf);
+}
+
+void printRow(uint8_t size, stats_t *stats)
+{
+	printColumn(size, 4);
+	for (uint8_t m = 0; m < NUM_MODES; m++)
+	{
+		Serial.print(F(" |"));
+		printColumn(stats[m].min, 5);
+		printColumn(stats[m].median, 5);
+		printColumn(stats[m].p99, 5);
+		printColumn(stats[m].max, 6);
+		printColumn(stats[m].failed, 4);
+	}
+	Serial.println();
+}
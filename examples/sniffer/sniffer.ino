@@ -0,0 +1,35 @@
+#include <SPI.h>
+#include <NRF24.h>
+#include <NRF24Capture.h>
+
+// Captures everything sent to the addresses below and streams it to Serial in binary
+// Save the serial output to a file and convert it with extras/host/nrf24_pcap.cpp
+// Nothing else may be printed while capturing
+// The radio doesn't ACK while capturing, see NRF24::setListenOnly() for chips that won't receive like that
+
+NRF24 radio;
+NRF24Capture capture(radio, Serial);
+
+// node addresses to listen to, at most 6
+uint8_t addresses[] = { 0xD2, 0xD3, 0xD4 };
+
+// room for bursts while the previous packets are still being printed
+nrf24_packet_t rxBuffer[16];
+
+void setup()
+{
+	// as fast as the USB serial converter goes, a 32 byte packet takes 43 bytes
+	Serial.begin(1000000);
+
+	// IRQ on pin 2 so the buffer fills while we're busy printing
+	radio.begin(9, 10, 0xC2C2C2C2, 2);
+	radio.setRXBuffer(rxBuffer, 16, true);
+	radio.setChannel(76);
+
+	capture.begin(addresses, sizeof(addresses));
+}
+
+void loop()
+{
+	capture.poll();
+}
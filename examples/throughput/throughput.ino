@@ -7,6 +7,10 @@ bool tx;
 
 #define PACKET_SIZE 32
 
+// Keep the TX FIFO full with sendBurst() instead of sending one packet at a time
+#define USE_BURST
+#define BURST_PACKETS 8
+
 void setup()
 {
 	Serial.begin(115200);
@@ -44,15 +48,23 @@ void loop()
 	if (tx)
 	{
 		// actual data is not important
+#ifdef USE_BURST
+		uint8_t buf[PACKET_SIZE * BURST_PACKETS];
+#else
 		uint8_t buf[PACKET_SIZE];
+#endif
 		uint32_t packetIndex = 0;
 		uint32_t time = micros();
 		uint32_t stopTime = time + 1000000;
 		while (true)
 		{
+#ifdef USE_BURST
+			packetIndex += radio.sendBurst(0xAA, buf, PACKET_SIZE, BURST_PACKETS);
+#else
 			bool sent = radio.send(0xAA, buf, PACKET_SIZE);
 			// bool sent = radio.broadcast(buf, PACKET_SIZE);
 			if (sent) ++packetIndex;
+#endif
 			if (micros() >= stopTime) break;
 		}
 
@@ -0,0 +1,188 @@
+#include "Arduino.h"
+#include "SPI.h"
+
+volatile uint8_t hostPorts[HOST_NUM_PORTS];
+
+SPIClass SPI;
+
+static uint32_t now;
+
+#define MAX_TIME_LISTENERS 8
+static host_time_listener_t timeListeners[MAX_TIME_LISTENERS];
+static void *timeListenerContexts[MAX_TIME_LISTENERS];
+static uint8_t numTimeListeners;
+
+#define MAX_INTERRUPTS 32
+static void (*interruptHandlers[MAX_INTERRUPTS])(void);
+static int interruptModes[MAX_INTERRUPTS];
+static uint32_t pendingInterrupts;
+static bool interruptsEnabled = true;
+
+/*********************************************************/
+
+static void runInterrupts()
+{
+	// like the real thing, no interrupts while a handler runs
+	while (interruptsEnabled && pendingInterrupts)
+	{
+		uint8_t i = 0;
+		while (!(pendingInterrupts & (1UL << i))) i++;
+		pendingInterrupts &= ~(1UL << i);
+
+		if (!interruptHandlers[i]) continue;
+
+		interruptsEnabled = false;
+		interruptHandlers[i]();
+		interruptsEnabled = true;
+	}
+}
+
+/*********************************************************/
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+	if (mode == INPUT_PULLUP) hostPorts[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+}
+
+/*********************************************************/
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+	if (value) hostPorts[digitalPinToPort(pin)] |= digitalPinToBitMask(pin);
+	else hostPorts[digitalPinToPort(pin)] &= ~digitalPinToBitMask(pin);
+}
+
+/*********************************************************/
+
+int digitalRead(uint8_t pin)
+{
+	return (hostPorts[digitalPinToPort(pin)] & digitalPinToBitMask(pin)) ? HIGH : LOW;
+}
+
+/*********************************************************/
+
+void attachInterrupt(uint8_t interruptNumber, void (*handler)(void), int mode)
+{
+	if (interruptNumber >= MAX_INTERRUPTS) return;
+	interruptHandlers[interruptNumber] = handler;
+	interruptModes[interruptNumber] = mode;
+}
+
+/*********************************************************/
+
+void detachInterrupt(uint8_t interruptNumber)
+{
+	if (interruptNumber >= MAX_INTERRUPTS) return;
+	interruptHandlers[interruptNumber] = NULL;
+}
+
+/*********************************************************/
+
+void noInterrupts()
+{
+	interruptsEnabled = false;
+}
+
+/*********************************************************/
+
+void interrupts()
+{
+	// anything that fired in between runs now
+	interruptsEnabled = true;
+	runInterrupts();
+}
+
+/*********************************************************/
+
+unsigned long millis()
+{
+	// always move a little so polling loops with a timeout terminate
+	hostAdvanceTime(1);
+	return now / 1000;
+}
+
+/*********************************************************/
+
+unsigned long micros()
+{
+	hostAdvanceTime(1);
+	return now;
+}
+
+/*********************************************************/
+
+void delay(unsigned long ms)
+{
+	hostAdvanceTime(ms * 1000);
+}
+
+/*********************************************************/
+
+void delayMicroseconds(unsigned int us)
+{
+	hostAdvanceTime(us);
+}
+
+/*********************************************************/
+
+long random(long max)
+{
+	if (max <= 0) return 0;
+	return rand() % max;
+}
+
+/*********************************************************/
+
+long random(long min, long max)
+{
+	if (max <= min) return min;
+	return min + random(max - min);
+}
+
+/*********************************************************/
+
+void randomSeed(unsigned long seed)
+{
+	srand(seed);
+}
+
+/*********************************************************/
+
+void hostAdvanceTime(uint32_t us)
+{
+	now += us;
+
+	for (uint8_t i = 0; i < numTimeListeners; i++)
+	{
+		timeListeners[i](timeListenerContexts[i], now);
+	}
+}
+
+/*********************************************************/
+
+void hostSetPin(uint8_t pin, uint8_t value)
+{
+	bool previous = digitalRead(pin);
+	digitalWrite(pin, value);
+
+	if (pin >= MAX_INTERRUPTS || !interruptHandlers[pin]) return;
+
+	int mode = interruptModes[pin];
+	if ((mode == FALLING && previous && !value) ||
+		(mode == RISING && !previous && value) ||
+		(mode == CHANGE && previous != (bool)value))
+	{
+		pendingInterrupts |= 1UL << pin;
+		runInterrupts();
+	}
+}
+
+/*********************************************************/
+
+void hostAddTimeListener(host_time_listener_t listener, void *context)
+{
+	if (numTimeListeners >= MAX_TIME_LISTENERS) return;
+	timeListeners[numTimeListeners] = listener;
+	timeListenerContexts[numTimeListeners] = context;
+	numTimeListeners++;
+}
@@ -0,0 +1,77 @@
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+// Just enough of the Arduino core to build the library on a PC, see README.md
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define INPUT			0x0
+#define OUTPUT			0x1
+#define INPUT_PULLUP	0x2
+
+#define LOW		0x0
+#define HIGH	0x1
+
+#define CHANGE	1
+#define FALLING	2
+#define RISING	3
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+#define PROGMEM
+#define memcpy_P memcpy
+
+class Print
+{
+	public:
+		virtual size_t write(uint8_t data) = 0;
+		virtual size_t write(const uint8_t *buffer, size_t size)
+		{
+			size_t n = 0;
+			while (size--) n += write(*buffer++);
+			return n;
+		}
+};
+
+// Every pin belongs to a fake 8 bit port so the port register tricks in the library work as usual
+#define HOST_NUM_PORTS 8
+extern volatile uint8_t hostPorts[HOST_NUM_PORTS];
+
+#define digitalPinToPort(pin)		((pin) / 8)
+#define digitalPinToBitMask(pin)	(1 << ((pin) % 8))
+#define portOutputRegister(port)	(&hostPorts[port])
+#define portInputRegister(port)		(&hostPorts[port])
+#define digitalPinToInterrupt(pin)	(pin)
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+
+void attachInterrupt(uint8_t interruptNumber, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interruptNumber);
+void noInterrupts();
+void interrupts();
+
+// Simulated time, it only moves when the code waits or talks to a peripheral
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+// Host side hooks
+void hostAdvanceTime(uint32_t us);
+void hostSetPin(uint8_t pin, uint8_t value);		// drive an input pin, fires attached interrupts unless disabled
+typedef void (*host_time_listener_t)(void *context, uint32_t now);
+void hostAddTimeListener(host_time_listener_t listener, void *context);
+
+#endif // HOST_ARDUINO_H_
@@ -0,0 +1,77 @@
+#ifndef NRF24MOCKTRANSPORT_H_
+#define NRF24MOCKTRANSPORT_H_
+
+#include "NRF24Transport.h"
+
+#define NRF24_MOCK_LOG_SIZE 512
+
+// Records everything the library sends and answers with canned bytes. Useful to check which commands
+// an API call results in and how many SPI transactions it takes, without a chip on the other end
+class NRF24MockTransport : public NRF24Transport
+{
+	public:
+		NRF24MockTransport(uint32_t clock = 4000000)
+		{
+			byteTime = 8000000 / clock;
+			if (byteTime == 0) byteTime = 1;
+			status = 0x0E;	// nothing happened, RX FIFO empty
+			reset();
+		}
+
+		virtual void begin() {}
+
+		virtual void beginTransaction()
+		{
+			++transactions;
+		}
+
+		virtual uint8_t transfer(uint8_t data)
+		{
+			if (logLength < NRF24_MOCK_LOG_SIZE) log[logLength++] = data;
+			++bytes;
+
+			// 8 bits at the SPI clock
+			hostAdvanceTime(byteTime);
+
+			if (responseLength) 
+			{
+				--responseLength;
+				return *response++;
+			}
+
+			return status;
+		}
+
+		// the next transfers return these bytes instead of status
+		void respond(const uint8_t *data, uint8_t length)
+		{
+			response = data;
+			responseLength = length;
+		}
+
+		void reset()
+		{
+			transactions = 0;
+			bytes = 0;
+			logLength = 0;
+			responseLength = 0;
+		}
+
+		// returned by every transfer unless respond() says otherwise
+		uint8_t status;
+
+		// counters since the last reset()
+		uint32_t transactions;
+		uint32_t bytes;
+
+		// the bytes sent, as far as they fit
+		uint8_t log[NRF24_MOCK_LOG_SIZE];
+		uint16_t logLength;
+
+	private:
+		uint32_t byteTime;
+		const uint8_t *response;
+		uint8_t responseLength;
+};
+
+#endif // NRF24MOCKTRANSPORT_H_
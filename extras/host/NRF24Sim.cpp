@@ -0,0 +1,960 @@
+#include "NRF24Sim.h"
+
+// how long the chip needs to switch between modes
+#define SETTLING_TIME 130
+
+/*********************************************************
+ *
+ * NRF24SimAir
+ *
+ *********************************************************/
+
+NRF24SimAir::NRF24SimAir()
+{
+	numChips = 0;
+	lossRate = 0;
+	advancing = false;
+	latest = 0;
+
+	for (uint8_t i = 0; i < NRF24_SIM_MAX_IN_FLIGHT; i++)
+	{
+		inFlight[i].sender = NULL;
+	}
+}
+
+/*********************************************************/
+
+void NRF24SimAir::setLossRate(float _lossRate)
+{
+	lossRate = _lossRate;
+}
+
+/*********************************************************/
+
+nrf24_sim_stats_t NRF24SimAir::getStats()
+{
+	nrf24_sim_stats_t total;
+	memset(&total, 0, sizeof(total));
+
+	for (uint8_t i = 0; i < numChips; i++)
+	{
+		nrf24_sim_stats_t stats = chips[i]->getStats();
+		total.spiTransactions += stats.spiTransactions;
+		total.spiBytes += stats.spiBytes;
+		total.airTime += stats.airTime;
+		total.packetsSent += stats.packetsSent;
+		total.retransmissions += stats.retransmissions;
+		total.packetsReceived += stats.packetsReceived;
+		total.packetsDropped += stats.packetsDropped;
+		total.duplicates += stats.duplicates;
+		total.acksSent += stats.acksSent;
+		total.csnErrors += stats.csnErrors;
+	}
+
+	return total;
+}
+
+/*********************************************************/
+
+void NRF24SimAir::addChip(NRF24Sim *chip)
+{
+	if (numChips >= NRF24_SIM_MAX_CHIPS) return;
+
+	// the air moves along with the host's time
+	if (numChips == 0) hostAddTimeListener(onTime, this);
+
+	chips[numChips++] = chip;
+}
+
+/*********************************************************/
+
+bool NRF24SimAir::lost()
+{
+	if (lossRate <= 0) return false;
+	return (float)rand() / (float)RAND_MAX < lossRate;
+}
+
+/*********************************************************/
+
+int8_t NRF24SimAir::startTransmission(NRF24Sim *sender, uint8_t channel, uint32_t start, uint32_t end)
+{
+	int8_t slot = -1;
+
+	for (uint8_t i = 0; i < NRF24_SIM_MAX_IN_FLIGHT; i++)
+	{
+		transmission_t &other = inFlight[i];
+
+		if (!other.sender)
+		{
+			if (slot < 0) slot = i;
+			continue;
+		}
+
+		// two packets on the same channel at the same time, neither makes it
+		if (other.channel == channel && other.end > start)
+		{
+			other.collided = true;
+			if (slot < 0 || inFlight[slot].sender) slot = -2;
+		}
+	}
+
+	bool collided = slot == -2;
+	if (collided)
+	{
+		slot = -1;
+		for (uint8_t i = 0; i < NRF24_SIM_MAX_IN_FLIGHT; i++)
+		{
+			if (!inFlight[i].sender)
+			{
+				slot = i;
+				break;
+			}
+		}
+	}
+
+	if (slot < 0) return -1;
+
+	inFlight[slot].sender = sender;
+	inFlight[slot].channel = channel;
+	inFlight[slot].start = start;
+	inFlight[slot].end = end;
+	inFlight[slot].collided = collided;
+
+	return slot;
+}
+
+/*********************************************************/
+
+bool NRF24SimAir::endTransmission(int8_t slot)
+{
+	// too much going on at once, count it as lost
+	if (slot < 0) return false;
+
+	inFlight[slot].sender = NULL;
+
+	return !inFlight[slot].collided;
+}
+
+/*********************************************************/
+
+bool NRF24SimAir::deliver(NRF24Sim *sender, nrf24_sim_packet_t &packet, uint32_t start, uint32_t end, nrf24_sim_payload_t *ack, uint32_t *ackEnd)
+{
+	bool acked = false;
+
+	for (uint8_t i = 0; i < numChips; i++)
+	{
+		NRF24Sim *chip = chips[i];
+		if (chip == sender) continue;
+
+		// has to be listening for the whole packet
+		if (chip->state != NRF24_SIM_RX || chip->rxSince > start) continue;
+
+		int8_t pipe = chip->matchPipe(packet);
+		if (pipe < 0) continue;
+
+		if (lost()) continue;
+
+		nrf24_sim_payload_t chipAck;
+		bool acking = false;
+		if (!chip->receive(pipe, packet, end, &chipAck, &acking)) continue;
+
+		// with several receivers ACKing only the first one counts
+		if (acking && !acked && !lost())
+		{
+			acked = true;
+			*ack = chipAck;
+			*ackEnd = chip->stateUntil;
+		}
+	}
+
+	return acked;
+}
+
+/*********************************************************/
+
+void NRF24SimAir::onTime(void *context, uint32_t now)
+{
+	((NRF24SimAir *)context)->advance(now);
+}
+
+/*********************************************************/
+
+void NRF24SimAir::advance(uint32_t now)
+{
+	latest = now;
+
+	// an interrupt handler doing SPI while we're handling events moves the time too, the loop below catches up
+	if (advancing) return;
+	advancing = true;
+
+	// events in the order they happen
+	while (true)
+	{
+		NRF24Sim *next = NULL;
+		uint32_t nextTime = 0;
+
+		for (uint8_t i = 0; i < numChips; i++)
+		{
+			uint32_t t = chips[i]->getNextEvent();
+			if (t <= latest && (!next || t < nextTime))
+			{
+				next = chips[i];
+				nextTime = t;
+			}
+		}
+
+		if (!next) break;
+
+		next->step(nextTime);
+	}
+
+	// pick up CE and register changes
+	for (uint8_t i = 0; i < numChips; i++)
+	{
+		chips[i]->step(latest);
+	}
+
+	advancing = false;
+}
+
+/*********************************************************
+ *
+ * NRF24Sim
+ *
+ *********************************************************/
+
+NRF24Sim::NRF24Sim(NRF24SimAir &_air, uint8_t _cePin, uint8_t _csnPin, uint8_t _irqPin, uint32_t spiClock)
+	: air(_air)
+{
+	cePin = _cePin;
+	csnPin = _csnPin;
+	irqPin = _irqPin;
+
+	byteTime = 8000000 / spiClock;
+	if (byteTime == 0) byteTime = 1;
+
+	startupTime = 1500;
+
+	reset();
+	resetStats();
+
+	air.addChip(this);
+}
+
+/*********************************************************/
+
+void NRF24Sim::begin()
+{
+	irqLow = false;
+	if (irqPin != NRF24_SIM_NO_PIN) hostSetPin(irqPin, HIGH);
+}
+
+/*********************************************************/
+
+void NRF24Sim::beginTransaction()
+{
+	++stats.spiTransactions;
+	commandIndex = 0;
+}
+
+/*********************************************************/
+
+void NRF24Sim::endTransaction()
+{
+	bool written = commandPayload.length > 0;
+
+	if ((command == W_TX_PAYLOAD || command == W_TX_PAYLOAD_NO_ACK) && written && txCount < 3)
+	{
+		commandPayload.noAck = command == W_TX_PAYLOAD_NO_ACK;
+		commandPayload.ackPayload = false;
+		txFifo[txCount++] = commandPayload;
+	}
+	else if ((command & 0xF8) == W_ACK_PAYLOAD && (command & 0x07) <= 5 && written && txCount < 3)
+	{
+		commandPayload.noAck = false;
+		commandPayload.ackPayload = true;
+		commandPayload.pipe = command & 0x07;
+		txFifo[txCount++] = commandPayload;
+	}
+	else if (command == R_RX_PAYLOAD && commandIndex > 1 && rxCount)
+	{
+		// the payload is gone once it's been read
+		--rxCount;
+		memmove(rxFifo, rxFifo + 1, rxCount * sizeof(nrf24_sim_payload_t));
+	}
+	else if (command == FLUSH_TX)
+	{
+		// whatever is written next is a new packet with a new ID, even if it's the same data
+		txCount = 0;
+		newPayload = true;
+	}
+	else if (command == FLUSH_RX)
+	{
+		rxCount = 0;
+	}
+
+	command = NOP;
+	commandIndex = 0;
+
+	updateIRQ();
+
+	// while the air is busy with events it catches up on its own
+	if (!air.advancing) step(air.latest);
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::transfer(uint8_t data)
+{
+	if (!csnIsLow()) ++stats.csnErrors;
+	++stats.spiBytes;
+
+	uint8_t result = 0;
+
+	if (commandIndex == 0)
+	{
+		// the chip clocks out STATUS while the command comes in
+		command = data;
+		commandPayload.length = 0;
+		result = getStatus();
+	}
+	else
+	{
+		uint8_t index = commandIndex - 1;
+
+		if (command < W_REGISTER)
+		{
+			result = readRegisterByte(command & REGISTER_MASK, index);
+		}
+		else if (command < W_REGISTER + 0x20)
+		{
+			writeRegisterByte(command & REGISTER_MASK, index, data);
+		}
+		else if (command == R_RX_PAYLOAD)
+		{
+			if (rxCount && index < rxFifo[0].length) result = rxFifo[0].data[index];
+		}
+		else if (command == R_RX_PL_WID)
+		{
+			if (rxCount && index == 0) result = rxFifo[0].length;
+		}
+		else if (command == W_TX_PAYLOAD || command == W_TX_PAYLOAD_NO_ACK || (command & 0xF8) == W_ACK_PAYLOAD)
+		{
+			if (commandPayload.length < 32) commandPayload.data[commandPayload.length++] = data;
+		}
+	}
+
+	++commandIndex;
+
+	// 8 bits at the SPI clock
+	hostAdvanceTime(byteTime);
+
+	return result;
+}
+
+/*********************************************************/
+
+void NRF24Sim::setStartupTime(uint16_t us)
+{
+	startupTime = us;
+}
+
+/*********************************************************/
+
+nrf24_sim_state_e NRF24Sim::getState()
+{
+	return state;
+}
+
+/*********************************************************/
+
+nrf24_sim_stats_t NRF24Sim::getStats()
+{
+	return stats;
+}
+
+/*********************************************************/
+
+void NRF24Sim::resetStats()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::getRegister(uint8_t reg)
+{
+	return readRegisterByte(reg & REGISTER_MASK, 0);
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::getRXFifoCount()
+{
+	return rxCount;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::getTXFifoCount()
+{
+	return txCount;
+}
+
+/*********************************************************
+ *
+ * PRIVATE
+ *
+ *********************************************************/
+
+void NRF24Sim::reset()
+{
+	// power on values from the datasheet
+	memset(registers, 0, sizeof(registers));
+	registers[CONFIG] = EN_CRC;
+	registers[EN_AA] = 0x3F;
+	registers[EN_RXADDR] = ERX_P0 | ERX_P1;
+	registers[SETUP_AW] = 0x03;
+	registers[SETUP_RETR] = 0x03;
+	registers[RF_CH] = 0x02;
+	registers[RF_SETUP] = 0x0E;
+	registers[RX_ADDR_P2] = 0xC3;
+	registers[RX_ADDR_P3] = 0xC4;
+	registers[RX_ADDR_P4] = 0xC5;
+	registers[RX_ADDR_P5] = 0xC6;
+
+	memset(rxAddressP0, 0xE7, 5);
+	memset(rxAddressP1, 0xC2, 5);
+	memset(txAddress, 0xE7, 5);
+
+	txCount = 0;
+	rxCount = 0;
+
+	command = NOP;
+	commandIndex = 0;
+	commandPayload.length = 0;
+
+	state = NRF24_SIM_POWER_DOWN;
+	stateUntil = 0;
+	rxSince = 0;
+	pid = 0;
+	newPayload = true;
+	retries = 0;
+	transmission = -1;
+	txStart = 0;
+	ackReceived = false;
+	ackPayload.length = 0;
+	memset(lastPid, 0xFF, sizeof(lastPid));
+	memset(lastCrc, 0, sizeof(lastCrc));
+
+	irqLow = false;
+}
+
+/*********************************************************/
+
+uint32_t NRF24Sim::getNextEvent()
+{
+	switch (state)
+	{
+		case NRF24_SIM_STARTUP:
+		case NRF24_SIM_RX_SETTLING:
+		case NRF24_SIM_TX_SETTLING:
+		case NRF24_SIM_TX:
+		case NRF24_SIM_TX_WAIT_ACK:
+		case NRF24_SIM_ACK:
+			return stateUntil;
+
+		default:
+			return 0xFFFFFFFF;
+	}
+}
+
+/*********************************************************/
+
+void NRF24Sim::step(uint32_t now)
+{
+	bool powered = registers[CONFIG] & PWR_UP;
+	bool prx = registers[CONFIG] & PRIM_RX;
+	bool ce = ceIsHigh();
+
+	if (!powered)
+	{
+		// anything in progress is cut off
+		if (state == NRF24_SIM_TX) air.endTransmission(transmission);
+		state = NRF24_SIM_POWER_DOWN;
+		return;
+	}
+
+	// keep going until nothing changes, several transitions can happen at the same moment
+	while (true)
+	{
+		nrf24_sim_state_e previous = state;
+
+		switch (state)
+		{
+			case NRF24_SIM_POWER_DOWN:
+				// PWR_UP was set in a way we didn't see
+				state = NRF24_SIM_STARTUP;
+				stateUntil = now + startupTime;
+				break;
+
+			case NRF24_SIM_STARTUP:
+				if (now >= stateUntil) state = NRF24_SIM_STANDBY1;
+				break;
+
+			case NRF24_SIM_STANDBY1:
+				if (!ce) break;
+
+				if (prx)
+				{
+					state = NRF24_SIM_RX_SETTLING;
+					stateUntil = now + SETTLING_TIME;
+				}
+				else if (txCount && !(registers[STATUS] & MAX_RT))
+				{
+					state = NRF24_SIM_TX_SETTLING;
+					stateUntil = now + SETTLING_TIME;
+				}
+				else
+				{
+					state = NRF24_SIM_STANDBY2;
+				}
+				break;
+
+			case NRF24_SIM_STANDBY2:
+				if (!ce || prx)
+				{
+					state = NRF24_SIM_STANDBY1;
+				}
+				else if (txCount && !(registers[STATUS] & MAX_RT))
+				{
+					state = NRF24_SIM_TX_SETTLING;
+					stateUntil = now + SETTLING_TIME;
+				}
+				break;
+
+			case NRF24_SIM_RX_SETTLING:
+				if (!ce || !prx)
+				{
+					state = NRF24_SIM_STANDBY1;
+				}
+				else if (now >= stateUntil)
+				{
+					state = NRF24_SIM_RX;
+					rxSince = stateUntil;
+				}
+				break;
+
+			case NRF24_SIM_RX:
+				if (!ce || !prx) state = NRF24_SIM_STANDBY1;
+				break;
+
+			case NRF24_SIM_TX_SETTLING:
+				// a CE pulse is enough to send a packet, no need to check it here
+				if (now >= stateUntil) startTransmission(stateUntil);
+				break;
+
+			case NRF24_SIM_TX:
+				if (now >= stateUntil)
+				{
+					uint32_t end = stateUntil;
+
+					nrf24_sim_packet_t packet;
+					memcpy(packet.address, txAddress, 5);
+					packet.addressWidth = addressWidth();
+					packet.channel = registers[RF_CH];
+					packet.dataRate = registers[RF_SETUP] & (RF_DR_LOW | RF_DR_HIGH);
+					packet.crcBytes = crcBytes();
+					packet.pid = pid;
+					packet.noAck = txFifo[0].noAck;
+					packet.length = txFifo[0].length;
+					memcpy(packet.data, txFifo[0].data, packet.length);
+
+					bool acked = false;
+					uint32_t ackEnd = 0;
+					if (air.endTransmission(transmission))
+					{
+						acked = air.deliver(this, packet, txStart, end, &ackPayload, &ackEnd);
+					}
+					transmission = -1;
+
+					if (packet.noAck)
+					{
+						ackReceived = false;
+						finishTransmission(end, true);
+						break;
+					}
+
+					// waits for the ACK until the retransmit delay is over, an ACK coming later is missed
+					uint32_t retransmitDelay = ((registers[SETUP_RETR] >> 4) + 1) * 250;
+					ackReceived = acked && ackEnd <= end + retransmitDelay;
+
+					state = NRF24_SIM_TX_WAIT_ACK;
+					stateUntil = ackReceived ? ackEnd : end + retransmitDelay;
+				}
+				break;
+
+			case NRF24_SIM_TX_WAIT_ACK:
+				if (now >= stateUntil)
+				{
+					if (ackReceived)
+					{
+						finishTransmission(stateUntil, true);
+					}
+					else if (retries < (registers[SETUP_RETR] & 0x0F))
+					{
+						++retries;
+						++stats.retransmissions;
+						startTransmission(stateUntil);
+					}
+					else
+					{
+						finishTransmission(stateUntil, false);
+					}
+				}
+				break;
+
+			case NRF24_SIM_ACK:
+				if (now >= stateUntil)
+				{
+					state = NRF24_SIM_RX_SETTLING;
+					stateUntil += SETTLING_TIME;
+				}
+				break;
+		}
+
+		if (state == previous) break;
+	}
+}
+
+/*********************************************************/
+
+void NRF24Sim::startTransmission(uint32_t now)
+{
+	if (!txCount)
+	{
+		state = ceIsHigh() ? NRF24_SIM_STANDBY2 : NRF24_SIM_STANDBY1;
+		return;
+	}
+
+	// retransmissions keep the packet ID
+	if (newPayload)
+	{
+		pid = (pid + 1) & 0x3;
+		retries = 0;
+		newPayload = false;
+	}
+
+	uint32_t duration = airTime(txFifo[0].length);
+
+	txStart = now;
+	transmission = air.startTransmission(this, registers[RF_CH], now, now + duration);
+
+	state = NRF24_SIM_TX;
+	stateUntil = now + duration;
+
+	++stats.packetsSent;
+	stats.airTime += duration;
+}
+
+/*********************************************************/
+
+void NRF24Sim::finishTransmission(uint32_t now, bool success)
+{
+	registers[OBSERVE_TX] = (registers[OBSERVE_TX] & 0xF0) | retries;
+
+	if (success)
+	{
+		if (txCount)
+		{
+			--txCount;
+			memmove(txFifo, txFifo + 1, txCount * sizeof(nrf24_sim_payload_t));
+		}
+		newPayload = true;
+
+		registers[STATUS] |= TX_DS;
+
+		// ACK payloads end up in the RX FIFO as if they came in on pipe 0
+		if (ackReceived && ackPayload.length && rxCount < 3)
+		{
+			ackPayload.pipe = 0;
+			rxFifo[rxCount++] = ackPayload;
+			registers[STATUS] |= RX_DR;
+		}
+	}
+	else
+	{
+		// payload stays in the FIFO, sent again with the same packet ID once MAX_RT is cleared
+		registers[STATUS] |= MAX_RT;
+		if ((registers[OBSERVE_TX] >> 4) < 15) registers[OBSERVE_TX] += 0x10;
+		retries = 0;
+	}
+
+	ackReceived = false;
+	updateIRQ();
+
+	bool ce = ceIsHigh();
+	if (ce && txCount && !(registers[STATUS] & MAX_RT))
+	{
+		state = NRF24_SIM_TX_SETTLING;
+		stateUntil = now + SETTLING_TIME;
+	}
+	else
+	{
+		state = ce ? NRF24_SIM_STANDBY2 : NRF24_SIM_STANDBY1;
+	}
+}
+
+/*********************************************************/
+
+int8_t NRF24Sim::matchPipe(nrf24_sim_packet_t &packet)
+{
+	if (packet.channel != registers[RF_CH]) return -1;
+	if (packet.dataRate != (registers[RF_SETUP] & (RF_DR_LOW | RF_DR_HIGH))) return -1;
+	if (packet.crcBytes != crcBytes()) return -1;
+	if (packet.addressWidth != addressWidth()) return -1;
+
+	uint8_t width = addressWidth();
+
+	for (uint8_t pipe = 0; pipe < 6; pipe++)
+	{
+		if (!(registers[EN_RXADDR] & (1 << pipe))) continue;
+
+		uint8_t address[5];
+		if (pipe == 0)
+		{
+			memcpy(address, rxAddressP0, 5);
+		}
+		else
+		{
+			// pipes 2-5 only have their own first byte, the rest is shared with pipe 1
+			memcpy(address, rxAddressP1, 5);
+			if (pipe > 1) address[0] = registers[RX_ADDR_P0 + pipe];
+		}
+
+		if (memcmp(address, packet.address, width) == 0) return pipe;
+	}
+
+	return -1;
+}
+
+/*********************************************************/
+
+bool NRF24Sim::receive(uint8_t pipe, nrf24_sim_packet_t &packet, uint32_t end, nrf24_sim_payload_t *ack, bool *acking)
+{
+	// static payload length has to match exactly. The datasheet only allows dynamic payloads on pipes with auto ACK
+	bool dynamic = (registers[FEATURE] & EN_DPL) && (registers[DYNPD] & (1 << pipe)) && (registers[EN_AA] & (1 << pipe));
+	if (!dynamic && packet.length != registers[RX_PW_P0 + pipe]) return false;
+
+	bool wantsAck = !packet.noAck && (registers[EN_AA] & (1 << pipe));
+
+	uint8_t crc = packet.length;
+	for (uint8_t i = 0; i < packet.length; i++)
+	{
+		crc = (crc << 1 | crc >> 7) ^ packet.data[i];
+	}
+
+	if (wantsAck && packet.pid == lastPid[pipe] && crc == lastCrc[pipe])
+	{
+		// same packet ID and CRC as last time, the sender missed our ACK. ACK again but don't store it twice
+		++stats.duplicates;
+	}
+	else
+	{
+		// no room, no ACK. The sender tries again
+		if (rxCount >= 3)
+		{
+			++stats.packetsDropped;
+			return false;
+		}
+
+		nrf24_sim_payload_t &payload = rxFifo[rxCount++];
+		memcpy(payload.data, packet.data, packet.length);
+		payload.length = packet.length;
+		payload.pipe = pipe;
+
+		registers[STATUS] |= RX_DR;
+		++stats.packetsReceived;
+
+		lastPid[pipe] = packet.pid;
+		lastCrc[pipe] = crc;
+	}
+
+	*acking = wantsAck;
+
+	if (wantsAck)
+	{
+		// first ACK payload queued for this pipe goes along
+		ack->length = 0;
+		for (uint8_t i = 0; i < txCount; i++)
+		{
+			if (txFifo[i].ackPayload && txFifo[i].pipe == pipe)
+			{
+				*ack = txFifo[i];
+				--txCount;
+				memmove(txFifo + i, txFifo + i + 1, (txCount - i) * sizeof(nrf24_sim_payload_t));
+
+				registers[STATUS] |= TX_DS;
+				break;
+			}
+		}
+
+		uint32_t duration = airTime(ack->length);
+
+		state = NRF24_SIM_ACK;
+		stateUntil = end + SETTLING_TIME + duration;
+
+		++stats.acksSent;
+		stats.airTime += duration;
+	}
+
+	updateIRQ();
+
+	return true;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::readRegisterByte(uint8_t reg, uint8_t index)
+{
+	switch (reg)
+	{
+		case RX_ADDR_P0:	return index < 5 ? rxAddressP0[index] : 0;
+		case RX_ADDR_P1:	return index < 5 ? rxAddressP1[index] : 0;
+		case TX_ADDR:		return index < 5 ? txAddress[index] : 0;
+	}
+
+	if (index > 0) return 0;
+
+	switch (reg)
+	{
+		case STATUS:		return getStatus();
+		case FIFO_STATUS:	return getFifoStatus();
+	}
+
+	return registers[reg];
+}
+
+/*********************************************************/
+
+void NRF24Sim::writeRegisterByte(uint8_t reg, uint8_t index, uint8_t value)
+{
+	switch (reg)
+	{
+		case RX_ADDR_P0:	if (index < 5) rxAddressP0[index] = value; return;
+		case RX_ADDR_P1:	if (index < 5) rxAddressP1[index] = value; return;
+		case TX_ADDR:		if (index < 5) txAddress[index] = value; return;
+	}
+
+	if (index > 0) return;
+
+	switch (reg)
+	{
+		case STATUS:
+			// writing 1 clears a flag
+			registers[STATUS] &= ~(value & (RX_DR | TX_DS | MAX_RT));
+			updateIRQ();
+			return;
+
+		// read only
+		case OBSERVE_TX:
+		case RPD:
+		case FIFO_STATUS:
+			return;
+
+		case CONFIG:
+			if ((value & PWR_UP) && !(registers[CONFIG] & PWR_UP))
+			{
+				state = NRF24_SIM_STARTUP;
+				stateUntil = air.latest + startupTime;
+			}
+			registers[CONFIG] = value;
+			updateIRQ();
+			return;
+	}
+
+	if (reg < sizeof(registers)) registers[reg] = value;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::getStatus()
+{
+	uint8_t status = registers[STATUS] & (RX_DR | TX_DS | MAX_RT);
+
+	// pipe number of the first payload in the RX FIFO, 7 when empty
+	status |= rxCount ? rxFifo[0].pipe << 1 : RX_P_NO_MASK;
+
+	if (txCount >= 3) status |= TX_FULL;
+
+	return status;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::getFifoStatus()
+{
+	uint8_t fifoStatus = 0;
+	if (txCount == 0) fifoStatus |= TX_EMPTY;
+	if (txCount >= 3) fifoStatus |= TX_FULL_FIFO;
+	if (rxCount == 0) fifoStatus |= RX_EMPTY;
+	if (rxCount >= 3) fifoStatus |= RX_FULL;
+	return fifoStatus;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::addressWidth()
+{
+	return (registers[SETUP_AW] & 0x3) + 2;
+}
+
+/*********************************************************/
+
+uint8_t NRF24Sim::crcBytes()
+{
+	// auto ACK forces CRC on
+	if (!(registers[CONFIG] & EN_CRC) && !registers[EN_AA]) return 0;
+	return (registers[CONFIG] & CRCO) ? 2 : 1;
+}
+
+/*********************************************************/
+
+uint32_t NRF24Sim::airTime(uint8_t payloadLength)
+{
+	// preamble, address, 9 bit packet control field, payload, CRC
+	uint32_t bits = 8 * (1 + addressWidth() + payloadLength + crcBytes()) + 9;
+
+	uint8_t rate = registers[RF_SETUP] & (RF_DR_LOW | RF_DR_HIGH);
+	if (rate & RF_DR_LOW) return bits * 4;		// 250kbps
+	if (rate & RF_DR_HIGH) return (bits + 1) / 2;	// 2Mbps
+	return bits;								// 1Mbps
+}
+
+/*********************************************************/
+
+bool NRF24Sim::ceIsHigh()
+{
+	return hostPorts[digitalPinToPort(cePin)] & digitalPinToBitMask(cePin);
+}
+
+/*********************************************************/
+
+bool NRF24Sim::csnIsLow()
+{
+	return !(hostPorts[digitalPinToPort(csnPin)] & digitalPinToBitMask(csnPin));
+}
+
+/*********************************************************/
+
+void NRF24Sim::updateIRQ()
+{
+	if (irqPin == NRF24_SIM_NO_PIN) return;
+
+	// active low while any flag is set that isn't masked in CONFIG
+	bool low = registers[STATUS] & ~registers[CONFIG] & (RX_DR | TX_DS | MAX_RT);
+	if (low == irqLow) return;
+
+	irqLow = low;
+	hostSetPin(irqPin, low ? LOW : HIGH);
+}
@@ -0,0 +1,210 @@
+#ifndef NRF24SIM_H_
+#define NRF24SIM_H_
+
+#include "NRF24Transport.h"
+#include "NRF24Reg.h"
+
+// Register level model of the NRF24L01+ for running the library on a PC (see README.md)
+//
+// Covers what the library uses: the register map, CE and CSN, the 3 deep TX and RX FIFOs, dynamic payloads
+// (only on pipes with auto ACK, like the datasheet asks for), auto ACK with ACK payloads, ARD/ARC retries, packet IDs, power up and settling times and the IRQ pin.
+// Every chip is a transport so the unmodified NRF24 class talks to it with setTransport().
+// Chips share an NRF24SimAir, which moves packets between them on simulated time.
+
+#define NRF24_SIM_MAX_CHIPS		8
+#define NRF24_SIM_MAX_IN_FLIGHT	8
+#define NRF24_SIM_NO_PIN		0xFF
+
+typedef enum
+{
+	NRF24_SIM_POWER_DOWN = 0,
+	NRF24_SIM_STARTUP,			// crystal starting after PWR_UP
+	NRF24_SIM_STANDBY1,
+	NRF24_SIM_STANDBY2,			// PTX with CE high and nothing to send
+	NRF24_SIM_RX_SETTLING,
+	NRF24_SIM_RX,
+	NRF24_SIM_TX_SETTLING,
+	NRF24_SIM_TX,				// packet on air
+	NRF24_SIM_TX_WAIT_ACK,
+	NRF24_SIM_ACK				// PRX sending an ACK, back to RX afterwards
+} nrf24_sim_state_e;
+
+typedef struct
+{
+	uint8_t data[32];
+	uint8_t length;
+	uint8_t pipe;				// RX FIFO: pipe it came in on, TX FIFO: pipe of an ACK payload
+	bool noAck;
+	bool ackPayload;
+} nrf24_sim_payload_t;
+
+typedef struct
+{
+	uint8_t address[5];
+	uint8_t addressWidth;
+	uint8_t channel;
+	uint8_t dataRate;
+	uint8_t crcBytes;
+	uint8_t pid;
+	bool noAck;
+	uint8_t data[32];
+	uint8_t length;
+} nrf24_sim_packet_t;
+
+// Counters, reset with NRF24Sim::resetStats()
+typedef struct
+{
+	uint32_t spiTransactions;
+	uint32_t spiBytes;
+	uint32_t airTime;			// uS spent transmitting, packets and ACKs
+	uint32_t packetsSent;		// including retransmissions
+	uint32_t retransmissions;
+	uint32_t packetsReceived;	// made it to the RX FIFO
+	uint32_t packetsDropped;	// addressed to us but the RX FIFO was full
+	uint32_t duplicates;		// dropped because of a repeated packet ID
+	uint32_t acksSent;
+	uint32_t csnErrors;			// SPI transfers while CSN was high
+} nrf24_sim_stats_t;
+
+class NRF24Sim;
+
+class NRF24SimAir
+{
+	public:
+		NRF24SimAir();
+
+		// chance of losing a packet or ACK, 0.0 - 1.0
+		void setLossRate(float lossRate);
+
+		nrf24_sim_stats_t getStats();	// totals of all chips
+
+	private:
+		friend class NRF24Sim;
+
+		typedef struct
+		{
+			NRF24Sim *sender;
+			uint8_t channel;
+			uint32_t start;
+			uint32_t end;
+			bool collided;
+		} transmission_t;
+
+		void addChip(NRF24Sim *chip);
+		bool lost();
+
+		// returns a slot to pass to endTransmission()
+		int8_t startTransmission(NRF24Sim *sender, uint8_t channel, uint32_t start, uint32_t end);
+		bool endTransmission(int8_t slot);
+
+		// delivers a packet sent by sender, returns true if it was ACKed. ack gets the ACK payload if there is one,
+		// ackEnd the time the ACK is off the air
+		bool deliver(NRF24Sim *sender, nrf24_sim_packet_t &packet, uint32_t start, uint32_t end, nrf24_sim_payload_t *ack, uint32_t *ackEnd);
+
+		static void onTime(void *context, uint32_t now);
+		void advance(uint32_t now);
+
+		NRF24Sim *chips[NRF24_SIM_MAX_CHIPS];
+		uint8_t numChips;
+
+		transmission_t inFlight[NRF24_SIM_MAX_IN_FLIGHT];
+
+		float lossRate;
+
+		bool advancing;
+		uint32_t latest;
+};
+
+class NRF24Sim : public NRF24Transport
+{
+	public:
+		// the pins are the ones passed to NRF24::begin(), the chip watches them through the fake port registers
+		NRF24Sim(NRF24SimAir &air, uint8_t cePin, uint8_t csnPin, uint8_t irqPin = NRF24_SIM_NO_PIN, uint32_t spiClock = 4000000);
+
+		// NRF24Transport
+		virtual void begin();
+		virtual void beginTransaction();
+		virtual void endTransaction();
+		virtual uint8_t transfer(uint8_t data);
+
+		// crystal startup time, 1500uS worst case, 150uS with an external crystal
+		void setStartupTime(uint16_t us);
+
+		nrf24_sim_state_e getState();
+		nrf24_sim_stats_t getStats();
+		void resetStats();
+
+		// direct look at the chip, bypassing SPI
+		uint8_t getRegister(uint8_t reg);
+		uint8_t getRXFifoCount();
+		uint8_t getTXFifoCount();
+
+	private:
+		friend class NRF24SimAir;
+
+		void reset();
+
+		// state machine, runs at every event and whenever time moves
+		void step(uint32_t now);
+		uint32_t getNextEvent();
+		void startTransmission(uint32_t now);
+		void finishTransmission(uint32_t now, bool acked);
+
+		// packets from the air
+		int8_t matchPipe(nrf24_sim_packet_t &packet);
+		bool receive(uint8_t pipe, nrf24_sim_packet_t &packet, uint32_t end, nrf24_sim_payload_t *ack, bool *acking);
+
+		uint8_t readRegisterByte(uint8_t reg, uint8_t index);
+		void writeRegisterByte(uint8_t reg, uint8_t index, uint8_t value);
+		uint8_t getStatus();
+		uint8_t getFifoStatus();
+		uint8_t addressWidth();
+		uint8_t crcBytes();
+		uint32_t airTime(uint8_t payloadLength);
+		bool ceIsHigh();
+		bool csnIsLow();
+		void updateIRQ();
+
+		NRF24SimAir &air;
+		uint8_t cePin;
+		uint8_t csnPin;
+		uint8_t irqPin;
+		uint8_t byteTime;
+		uint16_t startupTime;
+
+		// registers
+		uint8_t registers[0x20];
+		uint8_t rxAddressP0[5];
+		uint8_t rxAddressP1[5];
+		uint8_t txAddress[5];
+
+		nrf24_sim_payload_t txFifo[3];
+		uint8_t txCount;
+		nrf24_sim_payload_t rxFifo[3];
+		uint8_t rxCount;
+
+		// SPI command in progress
+		uint8_t command;
+		uint8_t commandIndex;
+		nrf24_sim_payload_t commandPayload;
+
+		// radio
+		nrf24_sim_state_e state;
+		uint32_t stateUntil;
+		uint32_t rxSince;
+		uint8_t pid;
+		bool newPayload;
+		uint8_t retries;
+		int8_t transmission;
+		uint32_t txStart;
+		bool ackReceived;
+		nrf24_sim_payload_t ackPayload;
+		uint8_t lastPid[6];
+		uint8_t lastCrc[6];
+
+		bool irqLow;
+
+		nrf24_sim_stats_t stats;
+};
+
+#endif // NRF24SIM_H_
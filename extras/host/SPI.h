@@ -0,0 +1,35 @@
+#ifndef HOST_SPI_H_
+#define HOST_SPI_H_
+
+#include "Arduino.h"
+
+#define SPI_HAS_TRANSACTION 1
+
+#define SPI_MODE0		0x00
+#define MSBFIRST		1
+#define SPI_CLOCK_DIV4	0x00
+
+class SPISettings
+{
+	public:
+		SPISettings() {}
+		SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) {}
+};
+
+// There's no SPI bus on a PC, use NRF24::setTransport() with one of the host transports
+class SPIClass
+{
+	public:
+		void begin() {}
+		void end() {}
+		void beginTransaction(SPISettings settings) {}
+		void endTransaction() {}
+		void usingInterrupt(uint8_t interruptNumber) {}
+		void setClockDivider(uint8_t divider) {}
+		uint8_t transfer(uint8_t data) { return 0xFF; }
+		void transfer(void *buf, size_t count) { memset(buf, 0xFF, count); }
+};
+
+extern SPIClass SPI;
+
+#endif // HOST_SPI_H_
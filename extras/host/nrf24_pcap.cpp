@@ -0,0 +1,122 @@
+// Converts a trace written by NRF24Capture into a pcap file, e.g. for Wireshark
+//
+// g++ extras/host/nrf24_pcap.cpp -o nrf24_pcap
+// nrf24_pcap trace.bin trace.pcap
+//
+// The trace is whatever came out of the serial port, e.g. from "cat /dev/ttyUSB0 > trace.bin" (set the baud rate
+// first) so it may start in the middle of a record or contain text printed before the capture started. Anything
+// that doesn't look like a record is skipped
+//
+// Packets use link type USER0 (147). Each one starts with channel, pipe and node address followed by the payload,
+// the timestamp is the sniffer's micros() (extended past the 32 bit wrap around)
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define SYNC1		0xA5
+#define SYNC2		0x5A
+#define HEADER_SIZE	7
+#define LINKTYPE	147
+
+static void write32(FILE *f, uint32_t v)
+{
+	fwrite(&v, 4, 1, f);
+}
+
+static void write16(FILE *f, uint16_t v)
+{
+	fwrite(&v, 2, 1, f);
+}
+
+int main(int argc, char **argv)
+{
+	if (argc != 3)
+	{
+		fprintf(stderr, "usage: %s trace.bin output.pcap\n", argv[0]);
+		return 1;
+	}
+
+	FILE *in = fopen(argv[1], "rb");
+	if (!in)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+
+	FILE *out = fopen(argv[2], "wb");
+	if (!out)
+	{
+		perror(argv[2]);
+		return 1;
+	}
+
+	// pcap header, host byte order (the magic number tells readers which)
+	write32(out, 0xA1B2C3D4);
+	write16(out, 2);
+	write16(out, 4);
+	write32(out, 0);
+	write32(out, 0);
+	write32(out, 65535);
+	write32(out, LINKTYPE);
+
+	unsigned long packets = 0;
+	unsigned long skipped = 0;
+	uint32_t previous = 0;
+	uint64_t wraps = 0;
+
+	int c;
+	int last = -1;
+	while ((c = fgetc(in)) != EOF)
+	{
+		if (last != SYNC1 || c != SYNC2)
+		{
+			last = c;
+			continue;
+		}
+		last = -1;
+
+		long start = ftell(in);
+
+		int length = fgetc(in);
+		if (length == EOF) break;
+
+		uint8_t body[256];
+		bool ok = length >= HEADER_SIZE && length <= HEADER_SIZE + 32 && fread(body, 1, length + 1, in) == (size_t)length + 1;
+
+		uint8_t checksum = 0;
+		for (int i = 0; ok && i < length; i++)
+		{
+			checksum += body[i];
+		}
+
+		if (!ok || checksum != body[length])
+		{
+			// not a record after all, look for the next sync from right after this one
+			++skipped;
+			fseek(in, start, SEEK_SET);
+			continue;
+		}
+
+		uint32_t timestamp = body[0] | (body[1] << 8) | (body[2] << 16) | ((uint32_t)body[3] << 24);
+		if (packets && timestamp < previous) wraps += 1ULL << 32;
+		previous = timestamp;
+		uint64_t us = wraps + timestamp;
+
+		uint32_t size = length - 4;
+		write32(out, us / 1000000);
+		write32(out, us % 1000000);
+		write32(out, size);
+		write32(out, size);
+		fwrite(body + 4, 1, size, out);
+
+		++packets;
+	}
+
+	fclose(in);
+	fclose(out);
+
+	printf("%lu packets, %lu bad records skipped\n", packets, skipped);
+
+	return 0;
+}
@@ -0,0 +1,198 @@
+// Checks of behaviour that went wrong before, on simulated radios. Prints a line per check and exits with 1 when
+// one of them fails
+//
+// g++ -I extras/host -I . NRF24.cpp NRF24Transport.cpp extras/host/Arduino.cpp extras/host/NRF24Sim.cpp extras/host/sim_check.cpp -o sim_check
+
+#include <stdio.h>
+#include <NRF24.h>
+#include "NRF24Sim.h"
+
+NRF24SimAir air;
+NRF24Sim chipA(air, 8, 9);
+NRF24Sim chipB(air, 10, 11, 12);
+NRF24Sim chipC(air, 13, 14);
+
+NRF24 radioA;
+NRF24 radioB;
+NRF24 radioC;
+
+nrf24_packet_t packetsB[4];
+nrf24_response_t responsesB[6];
+nrf24_packet_t packetsC[4];
+nrf24_source_t sourcesB[4];
+nrf24_source_t sourcesC[4];
+
+uint8_t failed;
+
+void check(const char *what, bool ok)
+{
+	printf("%-60s %s\n", what, ok ? "ok" : "FAIL");
+	if (!ok) ++failed;
+}
+
+void drain(NRF24 &radio)
+{
+	uint8_t buf[32];
+	while (radio.available()) radio.read(buf, sizeof(buf));
+}
+
+// with the IRQ pin, an ACK payload going out (TX_DS) must not hide the packet that took it
+void ackPayloadWithIRQ()
+{
+	uint8_t data[4] = { 1, 2, 3, 4 };
+	uint8_t response[] = "pong";
+	uint8_t buf[32];
+	uint8_t got = 0;
+
+	for (uint8_t i = 0; i < 5; i++)
+	{
+		radioB.queueResponse(response, sizeof(response));
+		data[0] = i;
+		radioA.send(2, data, sizeof(data), buf, sizeof(buf));
+		delay(1);
+
+		if (radioB.available() == sizeof(data))
+		{
+			radioB.read(buf, sizeof(buf));
+			if (buf[0] == i) ++got;
+		}
+		drain(radioB);
+	}
+
+	check("every packet that took an ACK payload is available", got == 5);
+}
+
+// a packet that came in before our own send is still there afterwards
+void receivedBeforeSend()
+{
+	uint8_t data[4] = { 5, 6, 7, 8 };
+	uint8_t buf[32];
+
+	radioA.send(2, data, sizeof(data));
+	delay(1);
+
+	radioB.send(1, data, sizeof(data));
+	bool waiting = radioB.available() == sizeof(data);
+	check("packet received before send() is available after it", waiting && radioB.read(buf, sizeof(buf)) && buf[0] == 5);
+	drain(radioB);
+	drain(radioA);
+}
+
+// packets with different content all arrive in order, the receiver's FIFO stops the burst once it's full
+void burstInOrder()
+{
+	uint8_t burst[8 * 32];
+	uint8_t buf[32];
+
+	for (uint16_t i = 0; i < sizeof(burst); i++) burst[i] = i / 32 + i;
+
+	uint16_t delivered = radioA.sendBurst(2, burst, 32, 8);
+	check("sendBurst() stops when the receiver's FIFO is full", delivered == 3);
+
+	uint8_t inOrder = 0;
+	while (radioB.available())
+	{
+		radioB.read(buf, sizeof(buf));
+		if (!memcmp(buf, burst + inOrder * 32, 32)) ++inOrder;
+	}
+	check("burst packets arrive intact and in order", inOrder == delivered);
+}
+
+// a send that fails with the IRQ pin must not take the queued responses along as data
+void failedSendWithResponses()
+{
+	uint8_t response[] = "RESP";
+	uint8_t data[4] = { 9, 9, 9, 9 };
+	uint8_t buf[32];
+
+	radioB.setRXBuffer(packetsB, 4);
+	radioB.setResponseBuffer(responsesB, 6);
+	for (uint8_t i = 0; i < 6; i++) radioB.queueResponse(response, sizeof(response));
+
+	// nobody listens to 3 yet
+	bool sent = radioB.send(3, data, sizeof(data));
+
+	radioC.startListening();
+	delay(5);
+
+	uint8_t leaked = 0;
+	while (radioC.available())
+	{
+		radioC.read(buf, sizeof(buf));
+		++leaked;
+	}
+
+	check("failed send() with the IRQ pin sends nothing afterwards", !sent && !leaked);
+
+	radioB.clearResponses();
+}
+
+// sequence numbers of packets to one receiver don't run into its window while the sender talks to another
+void taggingTwoReceivers()
+{
+	uint8_t data[4] = { 0 };
+	uint8_t buf[32];
+
+	radioA.setSequenceTagging(true);
+	radioB.setSequenceTagging(true);
+	radioC.setSequenceTagging(true);
+
+	radioC.setRXBuffer(packetsC, 4);
+	radioB.setDuplicateFilter(sourcesB, 4);
+	radioC.setDuplicateFilter(sourcesC, 4);
+
+	// more than the numbers wrap around in between
+	uint16_t toB = 0;
+	uint16_t toC = 0;
+	uint16_t sent = 0;
+	for (uint16_t round = 0; round < 3; round++)
+	{
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			data[0] = i;
+			sent += radioA.send(2, data, sizeof(data));
+			while (radioB.available()) toB += radioB.read(buf, sizeof(buf)) > 0;
+		}
+
+		for (uint16_t i = 0; i < 250; i++)
+		{
+			data[0] = i;
+			sent += radioA.send(3, data, sizeof(data));
+			while (radioC.available()) toC += radioC.read(buf, sizeof(buf)) > 0;
+		}
+	}
+
+	check("tagged packets to two receivers all get through the filter", toB + toC == sent && sent == 3 * 258);
+
+	radioA.setSequenceTagging(false);
+	radioB.setSequenceTagging(false);
+	radioC.setSequenceTagging(false);
+	radioB.setDuplicateFilter(NULL, 0);
+	radioC.setDuplicateFilter(NULL, 0);
+}
+
+int main()
+{
+	radioA.setTransport(chipA);
+	radioB.setTransport(chipB);
+	radioC.setTransport(chipC);
+
+	radioA.begin(8, 9);
+	radioB.begin(10, 11, 0xC2C2C2C2, 12);
+	radioC.begin(13, 14);
+
+	radioA.setAddress(1);
+	radioB.setAddress(2);
+	radioC.setAddress(3);
+
+	radioA.startListening();
+	radioB.startListening();
+
+	ackPayloadWithIRQ();
+	receivedBeforeSend();
+	burstInOrder();
+	failedSendWithResponses();
+	taggingTwoReceivers();
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+// A sender calling beginSend() as fast as it can to a receiver that reads a packet every 10 mS, for two seconds of
+// simulated time, without and with setFlowControl(). Prints the packets delivered and failed and what went over the
+// air, without flow control the sender retries into a full receiver until it gives up
+//
+// g++ -I extras/host -I . NRF24.cpp NRF24Transport.cpp extras/host/Arduino.cpp extras/host/NRF24Sim.cpp extras/host/sim_flow.cpp -o sim_flow
+
+#include <stdio.h>
+#include <NRF24.h>
+#include "NRF24Sim.h"
+
+#define SENDER 1
+#define RECEIVER 2
+
+#define READ_INTERVAL 10
+
+NRF24SimAir air;
+NRF24Sim chipA(air, 8, 9);
+NRF24Sim chipB(air, 10, 11, 12);
+
+NRF24 sender;
+NRF24 receiver;
+
+nrf24_packet_t senderPackets[4];
+nrf24_packet_t receiverPackets[4];
+
+void run(bool flowControl)
+{
+	sender.setFlowControl(flowControl);
+	receiver.setFlowControl(flowControl);
+
+	chipA.resetStats();
+
+	uint8_t data[16] = { 0 };
+	uint8_t buf[32];
+	uint16_t delivered = 0;
+	uint16_t failed = 0;
+	uint16_t received = 0;
+	uint16_t outOfOrder = 0;
+	uint8_t expected = 0;
+	bool pending = false;
+
+	uint32_t started = millis();
+	uint32_t lastRead = started;
+
+	while (millis() - started < 2000)
+	{
+		// the receiver's loop() is busy with other things most of the time
+		if (millis() - lastRead >= READ_INTERVAL)
+		{
+			lastRead = millis();
+			if (receiver.available())
+			{
+				receiver.read(buf, sizeof(buf));
+				if (buf[0] != expected) ++outOfOrder;
+				expected = buf[0] + 1;
+				++received;
+			}
+		}
+
+		// refused while the receiver is full
+		if (!pending) pending = sender.beginSend(RECEIVER, data, sizeof(data));
+
+		if (pending && sender.pollSend())
+		{
+			pending = false;
+			if (sender.sendResult() == NRF24_SEND_OK)
+			{
+				++delivered;
+				++data[0];
+			}
+			else ++failed;
+		}
+	}
+
+	while (pending && !sender.pollSend());
+	while (receiver.available()) receiver.read(buf, sizeof(buf));
+
+	nrf24_sim_stats_t stats = chipA.getStats();
+	printf("flow control %-3s %4u delivered, %4u failed, %4u read (%u out of order), %5u packets sent (%u retransmitted)\n",
+		flowControl ? "on" : "off", delivered, failed, received, outOfOrder, (unsigned)stats.packetsSent,
+		(unsigned)stats.retransmissions);
+}
+
+int main()
+{
+	sender.setTransport(chipA);
+	receiver.setTransport(chipB);
+
+	sender.begin(8, 9);
+	receiver.begin(10, 11, 0xC2C2C2C2, 12);
+
+	sender.setRXBuffer(senderPackets, 4);
+	receiver.setRXBuffer(receiverPackets, 4, true);
+
+	sender.setAddress(SENDER);
+	receiver.setAddress(RECEIVER);
+	receiver.startListening();
+
+	sender.setPowerPolicy(NRF24_POWER_ALWAYS_ON);
+	sender.setRetries(1, 15);
+
+	run(false);
+	run(true);
+
+	return 0;
+}
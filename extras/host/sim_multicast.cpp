@@ -0,0 +1,87 @@
+// NRF24Multicast pushing a 2000 byte message (72 packets) from one sender to a few receivers on simulated radios.
+// Prints how long it took, the packets the sender put on the air, the NACKs and how many receivers got all of it
+// Takes the loss rate, the number of receivers (max 7) and the quiet polls needed to finish as optional arguments
+//
+// g++ -I extras/host -I . NRF24.cpp NRF24Transport.cpp NRF24Multicast.cpp extras/host/Arduino.cpp extras/host/NRF24Sim.cpp extras/host/sim_multicast.cpp -o sim_multicast
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <NRF24.h>
+#include <NRF24Multicast.h>
+#include "NRF24Sim.h"
+
+#define GROUP 0x77
+#define LENGTH 2000
+#define MAX_NODES 8
+
+NRF24SimAir air;
+NRF24Sim *chips[MAX_NODES];
+NRF24 radios[MAX_NODES];
+NRF24Multicast *nodes[MAX_NODES];
+
+uint8_t message[LENGTH];
+uint8_t images[MAX_NODES][LENGTH];
+uint16_t completed[MAX_NODES];
+
+// the handlers don't know which node they're called for, poll() sets it
+uint8_t current;
+
+void onData(uint16_t offset, uint8_t *data, uint8_t length)
+{
+	memcpy(images[current] + offset, data, length);
+}
+
+void onComplete(uint16_t length)
+{
+	completed[current] = length;
+}
+
+int main(int argc, char **argv)
+{
+	float loss = argc > 1 ? atof(argv[1]) : 0.1;
+	uint8_t receivers = argc > 2 ? atoi(argv[2]) : 4;
+	if (receivers < 1) receivers = 1;
+	if (receivers > MAX_NODES - 1) receivers = MAX_NODES - 1;
+
+	for (uint16_t i = 0; i < LENGTH; i++) message[i] = i * 7 + (i >> 8);
+
+	// node 0 sends, all of them run the same code with their own address
+	for (uint8_t i = 0; i <= receivers; i++)
+	{
+		chips[i] = new NRF24Sim(air, 2 * i + 2, 2 * i + 3);
+		radios[i].setTransport(*chips[i]);
+		radios[i].begin(2 * i + 2, 2 * i + 3);
+		radios[i].setAddress(10 + i);
+		radios[i].setPowerPolicy(NRF24_POWER_ALWAYS_ON);
+
+		nodes[i] = new NRF24Multicast(radios[i], GROUP);
+		nodes[i]->begin();
+		nodes[i]->onData(onData);
+		nodes[i]->onComplete(onComplete);
+	}
+
+	if (argc > 3) nodes[0]->setRepairWindow(20, atoi(argv[3]));
+
+	air.setLossRate(loss);
+
+	uint32_t started = millis();
+	nodes[0]->push(message, LENGTH);
+
+	while (nodes[0]->getState() == NRF24_MULTICAST_SENDING)
+	{
+		for (current = 0; current <= receivers; current++) nodes[current]->poll();
+	}
+
+	uint32_t nacks = 0;
+	uint8_t complete = 0;
+	for (uint8_t i = 1; i <= receivers; i++)
+	{
+		nacks += chips[i]->getStats().packetsSent;
+		if (completed[i] == LENGTH && !memcmp(images[i], message, LENGTH)) ++complete;
+	}
+
+	printf("loss %.2f, %u receivers: %u mS, %u packets from the sender, %u NACKs, %u/%u complete\n", loss, receivers,
+		(unsigned)(millis() - started), (unsigned)chips[0]->getStats().packetsSent, (unsigned)nacks, complete, receivers);
+
+	return complete == receivers ? 0 : 1;
+}
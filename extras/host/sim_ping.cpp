@@ -0,0 +1,95 @@
+// Two simulated radios sending to each other, prints what each call costs in SPI traffic and time
+//
+// g++ -I extras/host -I . NRF24.cpp NRF24Transport.cpp extras/host/Arduino.cpp extras/host/NRF24Sim.cpp extras/host/sim_ping.cpp -o sim_ping
+
+#include <stdio.h>
+#include <NRF24.h>
+#include "NRF24Sim.h"
+
+NRF24SimAir air;
+NRF24Sim chipA(air, 8, 9);
+NRF24Sim chipB(air, 10, 11);
+
+NRF24 radioA;
+NRF24 radioB;
+
+uint32_t started;
+
+void mark()
+{
+	chipA.resetStats();
+	chipB.resetStats();
+	started = micros();
+}
+
+void report(const char *what)
+{
+	uint32_t elapsed = micros() - started;
+	nrf24_sim_stats_t stats = chipA.getStats();
+	printf("%-28s %4u transactions %5u bytes %6u uS, %u packets (%u retransmitted)\n", what,
+		(unsigned)stats.spiTransactions, (unsigned)stats.spiBytes, (unsigned)elapsed,
+		(unsigned)stats.packetsSent, (unsigned)stats.retransmissions);
+}
+
+int main()
+{
+	radioA.setTransport(chipA);
+	radioB.setTransport(chipB);
+
+	radioA.begin(8, 9);
+	radioB.begin(10, 11);
+
+	radioA.setAddress(1);
+	radioB.setAddress(2);
+	radioB.startListening();
+
+	uint8_t data[32];
+	for (uint8_t i = 0; i < sizeof(data); i++) data[i] = i;
+
+	uint8_t buf[32];
+
+	mark();
+	bool sent = radioA.send(2, data, 8);
+	report(sent ? "send() 8 bytes" : "send() 8 bytes FAILED");
+	while (radioB.available()) radioB.read(buf, sizeof(buf));
+
+	mark();
+	sent = radioA.send(2, data, 32);
+	report(sent ? "send() 32 bytes" : "send() 32 bytes FAILED");
+	while (radioB.available()) radioB.read(buf, sizeof(buf));
+
+	mark();
+	radioA.broadcast(data, 32);
+	report("broadcast() 32 bytes");
+	while (radioB.available()) radioB.read(buf, sizeof(buf));
+
+	uint8_t response[] = "pong";
+	radioB.queueResponse(response, sizeof(response));
+	mark();
+	int8_t received = radioA.send(2, data, 4, buf, sizeof(buf));
+	report(received > 0 ? "send() with response" : "send() with response FAILED");
+	while (radioB.available()) radioB.read(buf, sizeof(buf));
+
+	// the receiver only reads after the burst, the FIFO fills up and packets get retried
+	// every packet different, the chip takes packets with the same content and packet ID as sent again
+	static uint8_t burst[32 * 16];
+	for (uint16_t i = 0; i < sizeof(burst); i++) burst[i] = i / 32 + i;
+	mark();
+	uint16_t delivered = radioA.sendBurst(2, burst, 32, 16);
+	report("sendBurst() 16 x 32 bytes");
+	printf("  %u delivered, %u in the receiver's FIFO\n", delivered, chipB.getRXFifoCount());
+	while (radioB.available()) radioB.read(buf, sizeof(buf));
+
+	air.setLossRate(0.3);
+	uint8_t ok = 0;
+	mark();
+	for (uint8_t i = 0; i < 20; i++)
+	{
+		if (radioA.send(2, data, 16)) ++ok;
+		while (radioB.available()) radioB.read(buf, sizeof(buf));
+	}
+	report("20 x send() at 30% loss");
+	printf("  %u/20 delivered, %u duplicates discarded by the receiver\n", ok, (unsigned)chipB.getStats().duplicates);
+
+	return 0;
+}
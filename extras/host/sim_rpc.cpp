@@ -0,0 +1,127 @@
+// NRF24Rpc between a client and a server on two simulated radios, for a second of simulated time. Prints the calls
+// per second and packets per call with 1 and 6 calls in flight, and how often the server ran a method twice for the
+// same call. Takes a loss rate as an optional argument
+//
+// g++ -I extras/host -I . NRF24.cpp NRF24Transport.cpp NRF24Rpc.cpp extras/host/Arduino.cpp extras/host/NRF24Sim.cpp extras/host/sim_rpc.cpp -o sim_rpc
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <NRF24.h>
+#include <NRF24Rpc.h>
+#include "NRF24Sim.h"
+
+#define CLIENT 1
+#define SERVER 2
+
+NRF24SimAir air;
+NRF24Sim chipA(air, 8, 9);
+NRF24Sim chipB(air, 10, 11, 12);
+
+NRF24 client;
+NRF24 server;
+
+nrf24_packet_t clientPackets[4];
+nrf24_packet_t serverPackets[8];
+nrf24_response_t responses[8];
+
+// every call has its own number, the server counts how often it ran for each
+uint16_t runs[65536];
+uint16_t twice;
+
+uint8_t count(uint8_t from, uint8_t *data, uint8_t length, uint8_t *reply)
+{
+	uint16_t number = data[0] | (data[1] << 8);
+	if (runs[number]++) ++twice;
+
+	memcpy(reply, data, 2);
+	return 2;
+}
+
+nrf24_rpc_method_t methods[] = { count };
+
+uint16_t results[4];
+
+void onReply(int8_t call, nrf24_rpc_status_e status, uint8_t *data, uint8_t length)
+{
+	++results[status];
+}
+
+void run(uint8_t inFlight)
+{
+	nrf24_rpc_slot_t clientSlots[8];
+	nrf24_rpc_slot_t serverSlots[8];
+	NRF24Rpc rpcClient(client, clientSlots, 8);
+	NRF24Rpc rpcServer(server, serverSlots, 8);
+
+	rpcServer.setMethods(methods, 1);
+	rpcClient.onReply(onReply);
+
+	memset(runs, 0, sizeof(runs));
+	memset(results, 0, sizeof(results));
+	twice = 0;
+
+	chipA.resetStats();
+	chipB.resetStats();
+
+	uint16_t number = 0;
+	uint32_t started = millis();
+
+	while (millis() - started < 1000)
+	{
+		while (rpcClient.pending() < inFlight)
+		{
+			uint8_t data[2] = { (uint8_t)number, (uint8_t)(number >> 8) };
+			rpcClient.call(SERVER, 0, data, sizeof(data), 50);
+			++number;
+		}
+
+		rpcClient.poll();
+		rpcServer.poll();
+	}
+
+	// let the last ones finish, the next run starts with idle radios
+	while (rpcClient.pending())
+	{
+		rpcClient.poll();
+		rpcServer.poll();
+	}
+
+	while (!client.pollSend() || !server.pollSend());
+
+	nrf24_sim_stats_t clientStats = chipA.getStats();
+	nrf24_sim_stats_t serverStats = chipB.getStats();
+
+	printf("%u in flight: %5u calls/s, %4.2f packets per call (%u from the server), %u timeouts, %u failed, %u run twice\n",
+		inFlight, results[NRF24_RPC_OK], (float)(clientStats.packetsSent + serverStats.packetsSent) / number,
+		(unsigned)serverStats.packetsSent, results[NRF24_RPC_TIMEOUT], results[NRF24_RPC_SEND_FAILED], twice);
+}
+
+int main(int argc, char **argv)
+{
+	client.setTransport(chipA);
+	server.setTransport(chipB);
+
+	client.begin(8, 9);
+	server.begin(10, 11, 0xC2C2C2C2, 12);
+
+	client.setAddress(CLIENT);
+	server.setAddress(SERVER);
+
+	// replies only wait for the client's next packet in the response buffer
+	client.setRXBuffer(clientPackets, 4);
+	server.setRXBuffer(serverPackets, 8, true);
+	server.setResponseBuffer(responses, 8);
+
+	client.startListening();
+	server.startListening();
+
+	client.setRetries(1, 3);
+	server.setRetries(1, 3);
+
+	if (argc > 1) air.setLossRate(atof(argv[1]));
+
+	run(1);
+	run(6);
+
+	return 0;
+}
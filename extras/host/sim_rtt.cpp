@@ -0,0 +1,179 @@
+// Round trip times on two simulated radios, the same sweep as the rtt example: send() with ACK, send() with an ACK
+// payload and an echo from the other node's application, for every payload size, data rate and a few retry delays.
+// Prints min/median/p99/max in uS and the failures of each. Optionally takes a loss rate (0..1)
+//
+// g++ -I extras/host -I . NRF24.cpp NRF24Transport.cpp extras/host/Arduino.cpp extras/host/NRF24Sim.cpp extras/host/sim_rtt.cpp -o sim_rtt
+// ./sim_rtt 0.1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <NRF24.h>
+#include "NRF24Sim.h"
+
+#define INITIATOR 0xD1
+#define RESPONDER 0xD2
+
+#define SAMPLES 200
+#define ECHO_TIMEOUT 20000	// uS
+
+enum
+{
+	MODE_ACK = 0,
+	MODE_ACK_PAYLOAD,
+	MODE_ECHO,
+	NUM_MODES
+};
+
+typedef struct
+{
+	uint32_t min;
+	uint32_t median;
+	uint32_t p99;
+	uint32_t max;
+	uint16_t failed;
+} stats_t;
+
+NRF24SimAir air;
+NRF24Sim chipA(air, 8, 9);
+NRF24Sim chipB(air, 10, 11);
+
+NRF24 initiator;
+NRF24 responder;
+
+uint8_t mode;
+uint32_t samples[SAMPLES];
+
+const nrf24_datarate_e dataRates[] = { NRF24_250KBPS, NRF24_1MBPS, NRF24_2MBPS };
+const char *dataRateNames[] = { "250kbps", "1Mbps", "2Mbps" };
+const uint8_t retryDelays[] = { 0, 3, 15 };
+
+// what the responder's loop() does, the simulation only gets to it when we call it
+void respond()
+{
+	uint8_t buf[32];
+	uint8_t length;
+	while ((length = responder.receive(buf, sizeof(buf))))
+	{
+		if (mode == MODE_ACK_PAYLOAD) responder.queueResponse(buf, length);
+		else if (mode == MODE_ECHO) responder.send(INITIATOR, buf, length);
+	}
+}
+
+// the example sends this over the air, here both sides are simply set up the same
+void configure(nrf24_datarate_e dataRate, uint8_t m)
+{
+	respond();
+	responder.clearResponses();
+
+	initiator.setDataRate(dataRate);
+	responder.setDataRate(dataRate);
+	mode = m;
+
+	uint8_t first = 0;
+	if (mode == MODE_ACK_PAYLOAD) responder.queueResponse(&first, 1);
+}
+
+int compare(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+stats_t measure(uint8_t m, uint8_t size)
+{
+	uint8_t data[32] = { 0 };
+	uint8_t response[32];
+	uint16_t count = 0;
+	stats_t stats = { 0, 0, 0, 0, 0 };
+
+	for (uint16_t i = 0; i < SAMPLES; i++)
+	{
+		data[0] = i;
+		bool ok;
+
+		uint32_t started = micros();
+
+		if (m == MODE_ACK)
+		{
+			ok = initiator.send(RESPONDER, data, size);
+		}
+		else if (m == MODE_ACK_PAYLOAD)
+		{
+			ok = initiator.send(RESPONDER, data, size, response, sizeof(response)) > 0;
+		}
+		else
+		{
+			ok = initiator.send(RESPONDER, data, size);
+			while (ok && !initiator.receive(response, sizeof(response)))
+			{
+				respond();
+				if (micros() - started >= ECHO_TIMEOUT) ok = false;
+			}
+		}
+
+		uint32_t elapsed = micros() - started;
+
+		if (ok) samples[count++] = elapsed;
+		else ++stats.failed;
+
+		respond();
+		delay(2);
+		while (initiator.receive(response, sizeof(response)));
+	}
+
+	if (!count) return stats;
+
+	qsort(samples, count, sizeof(samples[0]), compare);
+	stats.min = samples[0];
+	stats.median = samples[count / 2];
+	stats.p99 = samples[(count - 1) * 99 / 100];
+	stats.max = samples[count - 1];
+	return stats;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc > 1) air.setLossRate(atof(argv[1]));
+
+	initiator.setTransport(chipA);
+	responder.setTransport(chipB);
+
+	initiator.begin(8, 9);
+	responder.begin(10, 11);
+
+	initiator.setPowerPolicy(NRF24_POWER_ALWAYS_ON);
+	responder.setPowerPolicy(NRF24_POWER_ALWAYS_ON);
+
+	initiator.setAddress(INITIATOR);
+	responder.setAddress(RESPONDER);
+	initiator.startListening();
+	responder.startListening();
+
+	for (uint8_t r = 0; r < sizeof(retryDelays); r++)
+	{
+		initiator.setRetries(retryDelays[r], 15);
+		responder.setRetries(retryDelays[r], 15);
+
+		for (uint8_t d = 0; d < sizeof(dataRates) / sizeof(dataRates[0]); d++)
+		{
+			printf("\n%s, retry delay %uuS. min/median/p99/max uS and failures\n", dataRateNames[d], (retryDelays[r] + 1) * 250);
+			printf("size | ACK                      | ACK payload              | echo\n");
+
+			for (uint8_t size = 1; size <= 32; size++)
+			{
+				printf("%4u", size);
+				for (uint8_t m = 0; m < NUM_MODES; m++)
+				{
+					configure(dataRates[d], m);
+					stats_t stats = measure(m, size);
+					printf(" |%5u%5u%5u%6u%4u", (unsigned)stats.min, (unsigned)stats.median, (unsigned)stats.p99,
+						(unsigned)stats.max, stats.failed);
+				}
+				printf("\n");
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,154 @@
+// NRF24Stream against calling send() for every packet (stop-and-wait), on two simulated radios. The receiver
+// runs like the loop() of a second microcontroller: every period uS of simulated time it reads what's there
+// Prints the throughput and how many packets went over the air for a few windows and receiver speeds
+//
+// g++ -I extras/host -I . NRF24.cpp NRF24Transport.cpp NRF24Stream.cpp extras/host/Arduino.cpp extras/host/NRF24Sim.cpp extras/host/sim_stream.cpp -o sim_stream
+
+#include <stdio.h>
+#include <NRF24.h>
+#include <NRF24Stream.h>
+#include "NRF24Sim.h"
+
+#define SENDER 0xA1
+#define RECEIVER 0xA2
+
+#define LENGTH 4000
+
+NRF24SimAir air;
+NRF24Sim chipA(air, 8, 9);
+NRF24Sim chipB(air, 10, 11);
+
+NRF24 sender;
+NRF24 receiver;
+
+NRF24Stream *senderStream;
+NRF24Stream *receiverStream;
+
+uint8_t message[LENGTH];
+uint8_t result[LENGTH];
+uint16_t received;
+
+uint32_t period;
+uint32_t nextRun;
+bool running;
+
+// the receiver's loop(), called as simulated time goes by
+void receiverLoop(void *context, uint32_t now)
+{
+	// its own SPI traffic moves the time along too
+	if (running || now < nextRun) return;
+	running = true;
+	nextRun = now + period;
+
+	uint8_t buf[32];
+	uint8_t length;
+
+	if (receiverStream)
+	{
+		while ((length = receiverStream->read(buf, sizeof(buf))))
+		{
+			if (received + length > LENGTH) length = LENGTH - received;
+			memcpy(result + received, buf, length);
+			received += length;
+		}
+	}
+	else
+	{
+		while ((length = receiver.receive(buf, sizeof(buf))))
+		{
+			if (received + length > LENGTH) length = LENGTH - received;
+			memcpy(result + received, buf, length);
+			received += length;
+		}
+	}
+
+	running = false;
+}
+
+void report(const char *what, uint16_t delivered, uint32_t elapsed)
+{
+	nrf24_sim_stats_t stats = chipA.getStats();
+	bool intact = received == LENGTH && !memcmp(result, message, LENGTH);
+
+	printf("%-24s %6u uS/loop %6u bytes/s %5u packets (%4u retransmitted)%s\n", what, (unsigned)period,
+		(unsigned)((uint64_t)delivered * 1000000 / elapsed), (unsigned)stats.packetsSent,
+		(unsigned)stats.retransmissions, intact ? "" : " INCOMPLETE");
+}
+
+void stopAndWait()
+{
+	chipA.resetStats();
+	received = 0;
+
+	uint32_t started = micros();
+	uint16_t delivered = 0;
+	for (uint16_t offset = 0; offset < LENGTH; offset += NRF24_STREAM_FRAME_SIZE)
+	{
+		uint8_t length = LENGTH - offset > NRF24_STREAM_FRAME_SIZE ? NRF24_STREAM_FRAME_SIZE : LENGTH - offset;
+		while (!sender.send(RECEIVER, message + offset, length));
+		delivered += length;
+	}
+
+	// let the receiver catch up
+	delay(5);
+	report("send() per packet", delivered, micros() - started);
+}
+
+void stream(uint8_t window)
+{
+	NRF24Stream tx(sender, window);
+	NRF24Stream rx(receiver, window);
+	senderStream = &tx;
+	receiverStream = &rx;
+
+	chipA.resetStats();
+	received = 0;
+
+	// the first read() queues the progress the sender asks for
+	delay(1);
+
+	uint32_t started = micros();
+	uint16_t delivered = tx.write(RECEIVER, message, LENGTH);
+	delay(5);
+
+	char what[32];
+	snprintf(what, sizeof(what), "NRF24Stream window %u", window);
+	report(what, delivered, micros() - started);
+
+	receiverStream = NULL;
+
+	// nothing left over for the next run
+	receiver.startListening();
+}
+
+int main()
+{
+	for (uint16_t i = 0; i < LENGTH; i++) message[i] = i * 7 + (i >> 8);
+
+	sender.setTransport(chipA);
+	receiver.setTransport(chipB);
+
+	sender.begin(8, 9);
+	receiver.begin(10, 11);
+
+	sender.setPowerPolicy(NRF24_POWER_ALWAYS_ON);
+	sender.setRetries(1, 15);
+	sender.setAddress(SENDER);
+
+	receiver.setAddress(RECEIVER);
+	receiver.startListening();
+
+	hostAddTimeListener(receiverLoop, NULL);
+
+	uint32_t periods[] = { 50, 300, 1000 };
+	for (uint8_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++)
+	{
+		period = periods[p];
+
+		stopAndWait();
+		stream(3);
+		stream(8);
+	}
+
+	return 0;
+}